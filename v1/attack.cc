@@ -2,8 +2,6 @@
 #include "daydreamer.h"
 #include <string.h>
 
-#define INVALID_DELTA   0xff
-
 int distance_data_storage[256];
 const int* distance_data = distance_data_storage+128;
 
@@ -11,36 +9,6 @@ const int* distance_data = distance_data_storage+128;
 attack_data_t board_attack_data_storage[256];
 const attack_data_t* board_attack_data = board_attack_data_storage + 128;
 
-// For each (from, to) pair, which pieces can attack squares 1 away from to?
-piece_flag_t near_attack_data_storage[256];
-const piece_flag_t* near_attack_data = near_attack_data_storage + 128;
-// For each piece and (from, to) pair, which squares need to be checked to
-// determine if the piece is almost attacking the |to| square?
-square_t near_attack_deltas[16][256][4];
-
-#define near_attack(from, to, piece) \
-    ((near_attack_data[(from)-(to)] & piece_flags[(piece)]) != 0)
-
-/*
- * Set attack data for a given combination of source and destination squares
- * and piece types. This is a helper function for |generate_attack_data|.
- */
-static void add_near_attack(square_t target,
-        square_t from,
-        int delta,
-        piece_t piece)
-{
-    near_attack_data_storage[128+from-target] |= get_piece_flag(piece);
-    int i = 0;
-    for (; near_attack_deltas[piece][128+from-target][i] != INVALID_DELTA;
-            ++i) {
-        if (near_attack_deltas[piece][128+from-target][i] == delta) return;
-    }
-    assert(near_attack_deltas[piece][128+from-target][i] == INVALID_DELTA);
-    if (i<3) near_attack_deltas[piece][128+from-target][i] = delta;
-    assert(near_attack_deltas[piece][128+from-target][0] != INVALID_DELTA);
-}
-
 /*
  * Calculate which pieces can attack from a given square to another square
  * for each possible (from,to) pair.
@@ -73,30 +41,6 @@ void generate_attack_data(void)
             }
         }
     }
-
-    memset((char*)near_attack_data_storage, 0, sizeof(piece_flag_t)*256);
-    for (int i=0; i<16; ++i)
-        for (int j=0; j<256; ++j)
-            for (int k=0; k<4; ++k)
-                near_attack_deltas[i][j][k] = INVALID_DELTA;
-    for (square_t target=A1; target<=H8; ++target) {
-        if (!valid_board_index(target)) continue;
-        for (square_t from=A1; from<=H8; ++from) {
-            if (!valid_board_index(from)) continue;
-            for (piece_t piece=WP; piece<=BK; ++piece) {
-                for (const direction_t* dir=piece_deltas[piece]; *dir; ++dir) {
-                    for (square_t to=from+*dir;
-                            valid_board_index(to); to+=*dir) {
-                        if (distance(target, to) == 1) {
-                            add_near_attack(target, from, to-from, piece);
-                            break;
-                        }
-                        if (piece_slide_type(piece) == NO_SLIDE) break;
-                    }
-                }
-            }
-        }
-    }
 }
 
 /*
@@ -125,33 +69,90 @@ direction_t pin_direction(const position_t* pos,
 }
 
 /*
- * Is |sq| being directly attacked by any pieces on |side|? Works on both
- * occupied and unoccupied squares.
+ * Find all pieces of either color that attack |sq|, treating |occupied| as
+ * the set of occupied squares. The board bitboards are kept up to date
+ * incrementally, so this is just a handful of table lookups. Passing an
+ * occupancy other than the real one lets callers see through pieces that
+ * are about to move.
  */
-bool is_square_attacked(const position_t* pos, square_t sq, color_t side)
+bitboard_t attackers_to(const position_t* pos, square_t sq, bitboard_t occupied)
 {
-    // For every opposing piece, look up the attack data for its square.
-    // Special-case pawns for efficiency.
-    piece_t opp_pawn = create_piece(side, PAWN);
-    if (pos->board[sq - piece_deltas[opp_pawn][0]] == opp_pawn) return true;
-    if (pos->board[sq - piece_deltas[opp_pawn][1]] == opp_pawn) return true;
+    const int index = square_to_index(sq);
+    const bitboard_t* bb = pos->piece_bb;
+    return (pawn_attacks[BLACK][index] & bb[WP]) |
+        (pawn_attacks[WHITE][index] & bb[BP]) |
+        (knight_attacks[index] & (bb[WN] | bb[BN])) |
+        (king_attacks[index] & (bb[WK] | bb[BK])) |
+        (bishop_attacks(index, occupied) &
+         (bb[WB] | bb[BB] | bb[WQ] | bb[BQ])) |
+        (rook_attacks(index, occupied) &
+         (bb[WR] | bb[BR] | bb[WQ] | bb[BQ]));
+}
 
-    square_t from;
-    for (const square_t* pfrom = &pos->pieces[side][0];
-            (from = *pfrom) != INVALID_SQUARE;
-            ++pfrom) {
-        piece_t p = pos->board[from];
-        if (possible_attack(from, sq, p)) {
-            if (piece_slide_type(p) == NO_SLIDE) return true;
-            direction_t att_dir = direction(from, sq);
-            while (from != sq) {
-                from += att_dir;
-                if (from == sq) return true;
-                if (pos->board[from] != EMPTY) break;
-            }
+/*
+ * Find all squares attacked by the piece on |from|.
+ */
+bitboard_t piece_attacks(const position_t* pos,
+        square_t from,
+        bitboard_t occupied)
+{
+    const int index = square_to_index(from);
+    const piece_t piece = pos->board[from];
+    switch (piece_type(piece)) {
+        case PAWN: return pawn_attacks[piece_color(piece)][index];
+        case KNIGHT: return knight_attacks[index];
+        case BISHOP: return bishop_attacks(index, occupied);
+        case ROOK: return rook_attacks(index, occupied);
+        case QUEEN: return queen_attacks(index, occupied);
+        case KING: return king_attacks[index];
+        default: assert(false);
+    }
+    return EMPTY_BB;
+}
+
+/*
+ * Find the pieces of |side| that are pinned to their own king: each one is
+ * the only piece standing between the king and an enemy slider. If
+ * |pinners| isn't NULL, the sliders doing the pinning are stored there.
+ */
+bitboard_t pinned_pieces(const position_t* pos,
+        color_t side,
+        bitboard_t* pinners)
+{
+    const color_t other_side = flip_color(side);
+    const int king = square_to_index(pos->pieces[side][0]);
+    const bitboard_t* bb = pos->piece_bb;
+    const bitboard_t occupied =
+        pos->occupied_bb[WHITE] | pos->occupied_bb[BLACK];
+    const bitboard_t queens = bb[create_piece(other_side, QUEEN)];
+    bitboard_t snipers = (bishop_attacks(king, EMPTY_BB) &
+            (bb[create_piece(other_side, BISHOP)] | queens)) |
+        (rook_attacks(king, EMPTY_BB) &
+            (bb[create_piece(other_side, ROOK)] | queens));
+    bitboard_t pinned = EMPTY_BB;
+    if (pinners) *pinners = EMPTY_BB;
+    while (snipers) {
+        const int sniper = first_bit(snipers);
+        snipers &= snipers - 1;
+        const bitboard_t blockers = between_mask[king][sniper] & occupied;
+        if (blockers && !(blockers & (blockers - 1)) &&
+                (blockers & pos->occupied_bb[side])) {
+            pinned |= blockers;
+            if (pinners) *pinners |= set_mask[sniper];
         }
     }
-    return false;
+    return pinned;
+}
+
+/*
+ * Is |sq| being directly attacked by any pieces on |side|? Works on both
+ * occupied and unoccupied squares.
+ */
+bool is_square_attacked(const position_t* pos, square_t sq, color_t side)
+{
+    const bitboard_t occupied =
+        pos->occupied_bb[WHITE] | pos->occupied_bb[BLACK];
+    return (attackers_to(pos, sq, occupied) & pos->occupied_bb[side]) != 0;
 }
 
 /*
@@ -159,24 +160,10 @@ bool is_square_attacked(const position_t* pos, square_t sq, color_t side)
  */
 bool piece_attacks_near(const position_t* pos, square_t from, square_t target)
 {
-    piece_t p = pos->board[from];
-    if (near_attack(from, target, p)) {
-        if (piece_slide_type(p) == NO_SLIDE) return true;
-        int delta;
-        for (int i=0; (delta = near_attack_deltas[p][128+from-target][i]) !=
-                INVALID_DELTA; ++i) {
-            square_t sq = from + delta;
-            if (pos->board[sq] == OUT_OF_BOUNDS) continue;
-            direction_t att_dir = direction(from, sq);
-            square_t x = from;
-            while (x != sq) {
-                x += att_dir;
-                if (x == sq) return true;
-                if (pos->board[x] != EMPTY) break;
-            }
-        }
-    }
-    return false;
+    const bitboard_t occupied =
+        pos->occupied_bb[WHITE] | pos->occupied_bb[BLACK];
+    return (piece_attacks(pos, from, occupied) &
+            king_attacks[square_to_index(target)]) != 0;
 }
 
 /*
@@ -186,46 +173,15 @@ bool piece_attacks_near(const position_t* pos, square_t from, square_t target)
  */
 uint8_t find_checks(position_t* pos)
 {
-    // For every opposing piece, look up the attack data for its square.
-    uint8_t attackers = 0;
-    pos->check_square = EMPTY;
-    color_t side = flip_color(pos->side_to_move);
-    square_t sq = pos->pieces[side^1][0];
-
-    // Special-case pawns for efficiency.
-    piece_t opp_pawn = create_piece(side, PAWN);
-    if (pos->board[sq - piece_deltas[opp_pawn][0]] == opp_pawn) {
-        pos->check_square = sq - piece_deltas[opp_pawn][0];
-        if (++attackers > 1) return attackers;
-    }
-    if (pos->board[sq - piece_deltas[opp_pawn][1]] == opp_pawn) {
-        pos->check_square = sq - piece_deltas[opp_pawn][1];
-        if (++attackers > 1) return attackers;
-    }
-
-    square_t from;
-    for (square_t* pfrom = &pos->pieces[side][1];
-            (from = *pfrom) != INVALID_SQUARE;
-            ++pfrom) {
-        piece_t p = pos->board[from];
-        if (possible_attack(from, sq, p)) {
-            if (piece_slide_type(p) == NO_SLIDE) {
-                pos->check_square = from;
-                if (++attackers > 1) return attackers;
-                continue;
-            }
-            square_t att_sq = from;
-            direction_t att_dir = direction(from, sq);
-            while (att_sq != sq) {
-                att_sq += att_dir;
-                if (att_sq == sq) {
-                    pos->check_square = from;
-                    if (++attackers > 1) return attackers;
-                }
-                if (pos->board[att_sq]) break;
-            }
-        }
+    const color_t side = flip_color(pos->side_to_move);
+    const bitboard_t occupied =
+        pos->occupied_bb[WHITE] | pos->occupied_bb[BLACK];
+    const bitboard_t checkers = pos->occupied_bb[side] &
+        attackers_to(pos, pos->pieces[side^1][0], occupied);
+    if (!checkers) {
+        pos->check_square = EMPTY;
+        return 0;
     }
-    return attackers;
+    pos->check_square = index_to_square(first_bit(checkers));
+    return (checkers & (checkers - 1)) ? 2 : 1;
 }
-
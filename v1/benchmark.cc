@@ -1,5 +1,9 @@
 
 #include "daydreamer.h"
+#include <ctype.h>
+#include <math.h>
+#include <stdio.h>
+#include <string.h>
 
 extern search_data_t root_data;
 const char* positions[] = {
@@ -22,34 +26,336 @@ const char* positions[] = {
     NULL
 };
 
+typedef enum {
+    BENCH_TEXT, BENCH_JSON, BENCH_CSV
+} bench_format_t;
+
+// Everything that can be set from the bench command line. Zero limits are
+// ignored, and zero hash or threads leave the current option alone.
+typedef struct {
+    int depth;
+    uint64_t node_limit;
+    int time_limit;
+    int hash_mbytes;
+    int threads;
+    int repeats;
+    bench_format_t format;
+    char filename[256];
+} bench_config_t;
+
+// The outcome of one search of one position.
+typedef struct {
+    uint64_t nodes;
+    int time;
+    int depth;
+    move_t best_move;
+} bench_result_t;
+
+#define bench_nps(nodes, time)  ((double)(nodes) * 1000.0 / MAX((time), 1))
+
+/*
+ * Read the bench command line into |config|. For compatibility, a bare
+ * number is taken as the depth.
+ */
+static void parse_bench_config(char* args, bench_config_t* config)
+{
+    memset(config, 0, sizeof(bench_config_t));
+    config->repeats = 1;
+    char* token;
+    while ((token = strsep(&args, " \t"))) {
+        if (!*token) continue;
+        char* value = NULL;
+        if (isdigit(*token)) {
+            config->depth = atoi(token);
+            continue;
+        }
+        while (args && (value = strsep(&args, " \t")) && !*value) {}
+        if (!value) break;
+        if (!strcasecmp(token, "depth")) config->depth = atoi(value);
+        else if (!strcasecmp(token, "nodes")) {
+            sscanf(value, "%"SCNu64, &config->node_limit);
+        } else if (!strcasecmp(token, "time")) config->time_limit = atoi(value);
+        else if (!strcasecmp(token, "hash")) config->hash_mbytes = atoi(value);
+        else if (!strcasecmp(token, "threads")) config->threads = atoi(value);
+        else if (!strcasecmp(token, "repeat")) config->repeats = atoi(value);
+        else if (!strcasecmp(token, "file")) {
+            snprintf(config->filename, sizeof(config->filename), "%s", value);
+        } else if (!strcasecmp(token, "format")) {
+            if (!strcasecmp(value, "json")) config->format = BENCH_JSON;
+            else if (!strcasecmp(value, "csv")) config->format = BENCH_CSV;
+            else config->format = BENCH_TEXT;
+        } else warn("Unrecognized bench option");
+    }
+    config->repeats = CLAMP(config->repeats, 1, 1000);
+    if (!config->depth && !config->node_limit && !config->time_limit) {
+        config->depth = 1;
+    }
+}
+
+/*
+ * Compare two doubles, for qsort.
+ */
+static int compare_doubles(const void* a, const void* b)
+{
+    double x = *(const double*)a, y = *(const double*)b;
+    return (x > y) - (x < y);
+}
+
+/*
+ * Find the median of |n| values. The values are sorted in the process.
+ */
+static double median(double* values, int n)
+{
+    qsort(values, n, sizeof(double), compare_doubles);
+    return n % 2 ? values[n/2] : (values[n/2 - 1] + values[n/2]) / 2;
+}
+
+/*
+ * Find the sample standard deviation of |n| values.
+ */
+static double std_dev(const double* values, int n)
+{
+    if (n < 2) return 0;
+    double mean = 0, sum_squares = 0;
+    for (int i=0; i<n; ++i) mean += values[i];
+    mean /= n;
+    for (int i=0; i<n; ++i) {
+        sum_squares += (values[i] - mean) * (values[i] - mean);
+    }
+    return sqrt(sum_squares / (n - 1));
+}
+
+/*
+ * Put the engine back in the state it's in right after startup, so that
+ * every repeat of a single-threaded bench searches exactly the same tree.
+ * In machine-readable formats the table allocation message is suppressed.
+ */
+static void reset_bench_state(const bench_config_t* config)
+{
+    root_data.quiet = config->format != BENCH_TEXT;
+    sync_transposition_table();
+    root_data.quiet = false;
+    clear_transposition_table();
+    clear_pv_cache();
+    clear_pawn_table();
+    clear_eval_cache();
+    clear_material_table();
+}
+
 /*
- * Search all of the benchmark positions either to the given depth or for the
- * given amount of time. The positions come directly from Glaurung's benchmark
- * suite.
+ * Search |fen| within the limits in |config|, and record what happened in
+ * |result|.
  */
-void benchmark(int depth, int time_limit)
+static void bench_position(const char* fen,
+        const bench_config_t* config,
+        bench_result_t* result)
 {
     milli_timer_t bench_timer;
-    uint64_t total_nodes = 0;
-    int time = 0;
     init_timer(&bench_timer);
-    for (int i=0; ; ++i) {
-        const char* fen = positions[i];
-        if (!fen) break;
-        init_search_data(&root_data);
-        set_position(&root_data.root_pos, fen);
-        print_board(&root_data.root_pos, false);
-        start_timer(&bench_timer);
-        root_data.time_target = root_data.time_limit = time_limit;
-        root_data.depth_limit = depth*PLY;
-        deepening_search(&root_data, false);
-        time = stop_timer(&bench_timer);
+    init_search_data(&root_data);
+    set_position(&root_data.root_pos, fen);
+    attach_hash_history(&root_data.root_pos, &root_data.hash_history);
+    root_data.quiet = config->format != BENCH_TEXT;
+    if (!root_data.quiet) print_board(&root_data.root_pos, false);
+    root_data.time_target = root_data.time_limit = config->time_limit;
+    root_data.node_limit = config->node_limit;
+    root_data.depth_limit = config->depth*PLY;
+    start_timer(&bench_timer);
+    deepening_search(&root_data, false);
+    result->time = stop_timer(&bench_timer);
+    result->nodes = total_nodes_searched(&root_data);
+    result->depth = (int)root_data.current_depth;
+    result->best_move = root_data.pv[0];
+    root_data.quiet = false;
+    if (config->format == BENCH_TEXT) {
         printf("time: %d\ndepth: %d\nnodes: %"PRIu64"\n",
-                time, (int)root_data.current_depth, root_data.nodes_searched);
-        total_nodes += root_data.nodes_searched;
+                result->time, result->depth, result->nodes);
     }
-    time = elapsed_time(&bench_timer);
-    printf("aggregate nodes %"PRIu64" time %d nps %"PRIu64"\n",
-            total_nodes, time, total_nodes/(time+1)*1000);
 }
 
+/*
+ * Print |str| as a json string.
+ */
+static void print_json_string(const char* str)
+{
+    putchar('"');
+    for (; *str; ++str) {
+        if (*str == '"' || *str == '\\') putchar('\\');
+        putchar(*str);
+    }
+    putchar('"');
+}
+
+/*
+ * Search all of the benchmark positions, or the positions in a file of fen
+ * or epd lines, within the limits given in |args|:
+ *   depth <d> nodes <n> time <ms> hash <mb> threads <t> repeat <r>
+ *   file <filename> format <text|json|csv>
+ * Each position's nodes, time, nps, depth reached and best move are reported
+ * for every repeat, along with the median and standard deviation of the
+ * times and speeds across repeats. Caches are cleared before each repeat, so
+ * with one thread the node counts should be identical every time; they're
+ * summarized in a signature which changes whenever the search does, but not
+ * when only its speed does. The default positions come directly from
+ * Glaurung's benchmark suite.
+ */
+void benchmark(char* args)
+{
+    bench_config_t config;
+    parse_bench_config(args, &config);
+    int num_positions = 0;
+    char** lines = NULL;
+    const char** fens = positions;
+    if (config.filename[0]) {
+        lines = read_epd_file(config.filename, &num_positions);
+        if (!lines) return;
+        fens = (const char**)lines;
+    } else {
+        while (positions[num_positions]) ++num_positions;
+    }
+
+    char saved_hash[128], saved_threads[128], option[256];
+    snprintf(saved_hash, 128, "%s", get_option_string("Hash"));
+    snprintf(saved_threads, 128, "%s", get_option_string("Threads"));
+    if (config.hash_mbytes) {
+        snprintf(option, 256, "Hash value %d", config.hash_mbytes);
+        set_uci_option(option);
+    }
+    if (config.threads) {
+        snprintf(option, 256, "Threads value %d", config.threads);
+        set_uci_option(option);
+    }
+
+    const int repeats = config.repeats;
+    bench_result_t* results = (bench_result_t*)malloc(
+            MAX(num_positions, 1) * repeats * sizeof(bench_result_t));
+    bench_result_t* totals =
+        (bench_result_t*)malloc(repeats * sizeof(bench_result_t));
+    for (int r=0; r<repeats; ++r) {
+        reset_bench_state(&config);
+        memset(&totals[r], 0, sizeof(bench_result_t));
+        for (int i=0; i<num_positions; ++i) {
+            bench_result_t* result = &results[i*repeats + r];
+            bench_position(fens[i], &config, result);
+            totals[r].nodes += result->nodes;
+            totals[r].time += result->time;
+        }
+        if (config.format == BENCH_TEXT) {
+            printf("aggregate nodes %"PRIu64" time %d nps %"PRIu64"\n",
+                    totals[r].nodes, totals[r].time,
+                    totals[r].nodes/(totals[r].time+1)*1000);
+        }
+    }
+
+    // The signature hashes the node count and best move of every position
+    // in the first repeat. Later repeats should match it exactly.
+    uint64_t signature = 0xcbf29ce484222325ull;
+    bool deterministic = true;
+    for (int i=0; i<num_positions; ++i) {
+        const bench_result_t* first = &results[i*repeats];
+        signature = (signature ^ first->nodes) * 0x100000001b3ull;
+        signature = (signature ^ first->best_move) * 0x100000001b3ull;
+        for (int r=1; r<repeats; ++r) {
+            if (first[r].nodes != first->nodes ||
+                    first[r].best_move != first->best_move) {
+                deterministic = false;
+            }
+        }
+    }
+
+    double* times = (double*)malloc(repeats * sizeof(double));
+    double* speeds = (double*)malloc(repeats * sizeof(double));
+    char move_str[7];
+    if (config.format == BENCH_JSON) {
+        printf("{\n  \"config\": {\"depth\": %d, \"nodes\": %"PRIu64
+                ", \"time\": %d, \"hash\": %d, \"threads\": %d"
+                ", \"repeat\": %d, \"positions\": %d},\n",
+                config.depth, config.node_limit, config.time_limit,
+                atoi(get_option_string("Hash")), get_num_threads(),
+                repeats, num_positions);
+        printf("  \"positions\": [\n");
+    } else if (config.format == BENCH_CSV) {
+        printf("run,position,nodes,time_ms,nps,depth,bestmove\n");
+    }
+    for (int i=0; i<=num_positions; ++i) {
+        const bool total = i == num_positions;
+        const bench_result_t* runs = total ? totals : &results[i*repeats];
+        for (int r=0; r<repeats; ++r) {
+            times[r] = runs[r].time;
+            speeds[r] = bench_nps(runs[r].nodes, runs[r].time);
+        }
+        const double nps_dev = std_dev(speeds, repeats);
+        const double time_dev = std_dev(times, repeats);
+        const double nps_median = median(speeds, repeats);
+        const double time_median = median(times, repeats);
+
+        if (config.format == BENCH_JSON) {
+            if (total) printf("  ],\n  \"total\": {\"runs\": [");
+            else {
+                printf("    {\"index\": %d, \"fen\": ", i+1);
+                print_json_string(fens[i]);
+                printf(", \"runs\": [");
+            }
+            for (int r=0; r<repeats; ++r) {
+                printf("%s{\"nodes\": %"PRIu64", \"time\": %d, \"nps\": %.0f",
+                        r ? ", " : "", runs[r].nodes, runs[r].time,
+                        bench_nps(runs[r].nodes, runs[r].time));
+                if (!total) {
+                    move_to_coord_str(runs[r].best_move, move_str);
+                    printf(", \"depth\": %d, \"bestmove\": \"%s\"",
+                            runs[r].depth, move_str);
+                }
+                printf("}");
+            }
+            printf("], \"time_median\": %.1f, \"time_stddev\": %.1f"
+                    ", \"nps_median\": %.0f, \"nps_stddev\": %.0f}%s\n",
+                    time_median, time_dev, nps_median, nps_dev,
+                    i+1 == num_positions ? "" : ",");
+        } else if (config.format == BENCH_CSV) {
+            for (int r=0; r<repeats; ++r) {
+                if (total) printf("%d,total,", r+1);
+                else printf("%d,%d,", r+1, i+1);
+                move_to_coord_str(runs[r].best_move, move_str);
+                printf("%"PRIu64",%d,%.0f,", runs[r].nodes, runs[r].time,
+                        bench_nps(runs[r].nodes, runs[r].time));
+                if (total) printf(",\n");
+                else printf("%d,%s\n", runs[r].depth, move_str);
+            }
+            if (total) printf("median,total,,%.1f,%.0f,,\n"
+                    "stddev,total,,%.1f,%.0f,,\n",
+                    time_median, nps_median, time_dev, nps_dev);
+            else printf("median,%d,,%.1f,%.0f,,\nstddev,%d,,%.1f,%.0f,,\n",
+                    i+1, time_median, nps_median, i+1, time_dev, nps_dev);
+        } else if (total && repeats > 1) {
+            printf("%d repeats: median time %.0f ms, median nps %.0f, "
+                    "nps stddev %.0f (%.1f%%)\n", repeats, time_median,
+                    nps_median, nps_dev, 100.0 * nps_dev / MAX(nps_median, 1));
+        }
+    }
+    if (config.format == BENCH_JSON) {
+        printf("  \"signature\": {\"nodes\": %"PRIu64", \"hash\": \"%016"
+                PRIx64"\", \"deterministic\": %s}\n}\n",
+                totals[0].nodes, signature, deterministic ? "true" : "false");
+    } else if (config.format == BENCH_CSV) {
+        printf("signature,total,%"PRIu64",,,,%016"PRIx64"\n",
+                totals[0].nodes, signature);
+    } else {
+        printf("signature nodes %"PRIu64" hash %016"PRIx64"%s\n",
+                totals[0].nodes, signature,
+                deterministic ? "" : " (results varied between repeats)");
+    }
+
+    free(times);
+    free(speeds);
+    free(results);
+    free(totals);
+    if (lines) free_epd_file(lines, num_positions);
+    if (config.hash_mbytes) {
+        snprintf(option, 256, "Hash value %s", saved_hash);
+        set_uci_option(option);
+    }
+    if (config.threads) {
+        snprintf(option, 256, "Threads value %s", saved_threads);
+        set_uci_option(option);
+    }
+}
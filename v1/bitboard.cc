@@ -1,5 +1,6 @@
 
 #include "daydreamer.h"
+#include <string.h>
 
 bitboard_t rank_mask[8] = {
     RANK_1_BB, RANK_2_BB, RANK_3_BB, RANK_4_BB,
@@ -18,6 +19,107 @@ bitboard_t clear_mask[64];
 bitboard_t in_front_mask[2][64];
 bitboard_t outpost_mask[2][64];
 bitboard_t passed_mask[2][64];
+bitboard_t knight_attacks[64];
+bitboard_t king_attacks[64];
+bitboard_t pawn_attacks[2][64];
+bitboard_t between_mask[64][64];
+bitboard_t line_mask[64][64];
+magic_t bishop_magics[64];
+magic_t rook_magics[64];
+
+// Shared storage for all of the magic attack tables. Each square gets
+// 2^(number of relevant occupancy bits) entries.
+static bitboard_t bishop_attack_table[5248];
+static bitboard_t rook_attack_table[102400];
+
+// Magic multipliers for each square. These were found by trying sparse
+// random numbers until one mapped every relevant occupancy without a
+// harmful collision.
+static const bitboard_t bishop_magic_numbers[64] = {
+    0x10102002004A1420ull, 0x8020040400584008ull,
+    0x10510800811201C8ull, 0x5204042080000088ull,
+    0x2204106880000002ull, 0x1401042004000000ull,
+    0x0400880410042004ull, 0x0028208200A02020ull,
+    0x1500241990010E00ull, 0x8001200182020A40ull,
+    0x40004101030B0000ull, 0x8002041042000100ull,
+    0x4010011041020038ull, 0x0000010421044000ull,
+    0x1500210808020A00ull, 0x8000088400880520ull,
+    0x0405004010040100ull, 0x1005823210040108ull,
+    0x2708008102040011ull, 0x4048200404009100ull,
+    0x0018104101400024ull, 0x0003000601190101ull,
+    0x8004803108491000ull, 0x8014241200820800ull,
+    0x0006E080100C3040ull, 0x0501044A11041800ull,
+    0x9020300008004045ull, 0x0894080000220040ull,
+    0x1001010083104000ull, 0x5004030040900080ull,
+    0x000400422C012400ull, 0x0002128698404812ull,
+    0x1010108404900440ull, 0x0928021182084100ull,
+    0x2006080409020024ull, 0x1010202020180080ull,
+    0xA010008200202200ull, 0x2098015100019004ull,
+    0x0002041440810811ull, 0x802A02020000B098ull,
+    0x0009015090004060ull, 0x4000821082081001ull,
+    0x0100210040420800ull, 0x0800004010488A00ull,
+    0x2000081104004040ull, 0x4C8E029015000082ull,
+    0x0420340322224842ull, 0x1298260043400210ull,
+    0x0000822802400008ull, 0x00008A0101600000ull,
+    0x3040003412080021ull, 0x3040290220884800ull,
+    0x4A1500401041004Aull, 0x8010200282020781ull,
+    0x0020203142209091ull, 0x0070300600902110ull,
+    0x0040808800B62048ull, 0x0000810400C44420ull,
+    0x00080400440C0441ull, 0x8340080020840411ull,
+    0x0000000104208200ull, 0x0000800810D00080ull,
+    0x0400530411080200ull, 0x4040702400932244ull,
+};
+static const bitboard_t rook_magic_numbers[64] = {
+    0x1080004008801020ull, 0x0840092002C03000ull,
+    0x1900200010400900ull, 0x0880100008000480ull,
+    0x4200100420080200ull, 0x8100020100080400ull,
+    0x0200040110886200ull, 0x0200008040220411ull,
+    0x0404800084400220ull, 0x0000401000402000ull,
+    0x0086001081220440ull, 0x0408800800100280ull,
+    0x000A001201040820ull, 0x8848800200840080ull,
+    0x4001000100040200ull, 0x0442000102105084ull,
+    0x9080010020804100ull, 0x0040404000201009ull,
+    0x0000808010002009ull, 0x2200090021D00100ull,
+    0x0008008008040080ull, 0x0004004002010040ull,
+    0x0011040008015042ull, 0x00000A0001768104ull,
+    0x0000800080204009ull, 0x2010004140002001ull,
+    0x9800200280100080ull, 0x1000100080080080ull,
+    0x0442000A00049020ull, 0x2100040080020080ull,
+    0x0800120400900148ull, 0x0010040A00128541ull,
+    0x2800804000800030ull, 0x1010002000400041ull,
+    0x4000200011004100ull, 0x0610008410800800ull,
+    0x0400802402800800ull, 0xC100020080800400ull,
+    0x0002000802000401ull, 0x0182085882000401ull,
+    0x0220204000808000ull, 0x2860100040024022ull,
+    0x0001002004110040ull, 0x99101042000A0020ull,
+    0x0004080004008080ull, 0x0010040002008080ull,
+    0x2012004881020004ull, 0x8300842444820011ull,
+    0x0088403882010200ull, 0x0820400080210100ull,
+    0x0110910040A00300ull, 0x0801100280080480ull,
+    0x0242009008200600ull, 0x1002000489500200ull,
+    0x0040800200010080ull, 0x0091800041000080ull,
+    0x0000209300488001ull, 0x04C1002414824001ull,
+    0x020020000B001041ull, 0x7000100004200901ull,
+    0x8002002004100802ull, 0x30010002084C0007ull,
+    0x0888221800813004ull, 0x4000002840840112ull,
+};
+
+// Rays in each direction from each square. The first four directions run
+// toward higher bit indices, the last four toward lower ones, and each
+// direction is four away from its opposite.
+static bitboard_t ray_mask[8][64];
+static const direction_t ray_directions[8] = { N, E, NE, NW, S, W, SW, SE };
+static const int reverse_bit_table[64] = {
+     0, 47,  1, 56, 48, 27,  2, 60,
+    57, 49, 41, 37, 28, 16,  3, 61,
+    54, 58, 35, 52, 50, 42, 21, 44,
+    38, 32, 29, 23, 17, 11,  4, 62,
+    46, 55, 26, 59, 40, 36, 15, 53,
+    34, 51, 20, 43, 31, 22, 10, 45,
+    25, 39, 14, 33, 19, 30,  9, 24,
+    13, 18,  8, 12,  7,  6,  5, 63
+};
+
 const int bit_table[64] = {
      0,  1,  2,  7,  3, 13,  8, 19,
      4, 25, 14, 28,  9, 34, 20, 40,
@@ -29,6 +131,164 @@ const int bit_table[64] = {
     61, 22, 43, 51, 60, 42, 59, 58
 };
 
+/*
+ * Set the bits in |bb| for each square reachable from |sq| in one step in
+ * one of the given directions.
+ */
+static bitboard_t step_attacks(square_t sq, const direction_t* deltas, int n)
+{
+    bitboard_t bb = EMPTY_BB;
+    for (int i=0; i<n; ++i) {
+        square_t to = sq + deltas[i];
+        if (valid_board_index(to)) bb |= sq_bit(to);
+    }
+    return bb;
+}
+
+/*
+ * Fill in the tables of piece attacks and the rays, lines, and between
+ * masks used for sliding pieces. These are built by walking the 0x88 board,
+ * so that they agree with the rest of the move generation code.
+ */
+static void init_attack_tables(void)
+{
+    static const direction_t knight_deltas[8] =
+        { SSW, SSE, WSW, ESE, WNW, ENE, NNW, NNE };
+    static const direction_t king_deltas[8] =
+        { SW, S, SE, W, E, NW, N, NE };
+    static const direction_t pawn_deltas[2][2] = { { NW, NE }, { SW, SE } };
+    memset(between_mask, 0, sizeof(between_mask));
+    memset(line_mask, 0, sizeof(line_mask));
+    for (square_t sq=A1; sq<=H8; ++sq) {
+        if (!valid_board_index(sq)) continue;
+        const int index = square_to_index(sq);
+        knight_attacks[index] = step_attacks(sq, knight_deltas, 8);
+        king_attacks[index] = step_attacks(sq, king_deltas, 8);
+        pawn_attacks[WHITE][index] = step_attacks(sq, pawn_deltas[WHITE], 2);
+        pawn_attacks[BLACK][index] = step_attacks(sq, pawn_deltas[BLACK], 2);
+        for (int dir=0; dir<8; ++dir) {
+            ray_mask[dir][index] = EMPTY_BB;
+            for (square_t to=sq+ray_directions[dir];
+                    valid_board_index(to); to+=ray_directions[dir]) {
+                ray_mask[dir][index] |= sq_bit(to);
+            }
+        }
+    }
+    for (square_t sq=A1; sq<=H8; ++sq) {
+        if (!valid_board_index(sq)) continue;
+        const int index = square_to_index(sq);
+        for (int dir=0; dir<8; ++dir) {
+            const bitboard_t line = ray_mask[dir][index] |
+                ray_mask[(dir+4)%8][index] | set_mask[index];
+            bitboard_t between = EMPTY_BB;
+            for (square_t to=sq+ray_directions[dir];
+                    valid_board_index(to); to+=ray_directions[dir]) {
+                const int to_index = square_to_index(to);
+                between_mask[index][to_index] = between;
+                line_mask[index][to_index] = line;
+                between |= set_mask[to_index];
+            }
+        }
+    }
+}
+
+/*
+ * Find the index of the highest set bit in |bb|, which must be non-empty.
+ */
+static int last_bit(bitboard_t bb)
+{
+    bb |= bb >> 1;
+    bb |= bb >> 2;
+    bb |= bb >> 4;
+    bb |= bb >> 8;
+    bb |= bb >> 16;
+    bb |= bb >> 32;
+    return reverse_bit_table[(bb * 0x03F79D71B4CB0A89ull) >> 58];
+}
+
+/*
+ * Squares attacked along the ray in direction |dir| from |index|, stopping
+ * at the first occupied square.
+ */
+static bitboard_t ray_attacks(int dir, int index, bitboard_t occupied)
+{
+    bitboard_t attacks = ray_mask[dir][index];
+    bitboard_t blockers = attacks & occupied;
+    if (blockers) {
+        int blocker = dir < 4 ? first_bit(blockers) : last_bit(blockers);
+        attacks ^= ray_mask[dir][blocker];
+    }
+    return attacks;
+}
+
+/*
+ * Squares attacked by a bishop on |index|, given the occupied squares. This
+ * walks the rays directly, and is only used to fill in the magic tables.
+ */
+static bitboard_t slow_bishop_attacks(int index, bitboard_t occupied)
+{
+    return ray_attacks(2, index, occupied) | ray_attacks(3, index, occupied) |
+        ray_attacks(6, index, occupied) | ray_attacks(7, index, occupied);
+}
+
+/*
+ * Squares attacked by a rook on |index|, given the occupied squares.
+ */
+static bitboard_t slow_rook_attacks(int index, bitboard_t occupied)
+{
+    return ray_attacks(0, index, occupied) | ray_attacks(1, index, occupied) |
+        ray_attacks(4, index, occupied) | ray_attacks(5, index, occupied);
+}
+
+/*
+ * Count the set bits in |bb|, for processors without a popcount
+ * instruction.
+ */
+int slow_pop_count(bitboard_t bb)
+{
+    bb -= (bb >> 1) & 0x5555555555555555ull;
+    bb = (bb & 0x3333333333333333ull) + ((bb >> 2) & 0x3333333333333333ull);
+    bb = (bb + (bb >> 4)) & 0x0F0F0F0F0F0F0F0Full;
+    return (int)((bb * 0x0101010101010101ull) >> 56);
+}
+
+/*
+ * Fill in the magic lookup data for each square. Each relevant occupancy is
+ * mapped through the square's magic multiplier onto a slot in |table|, and
+ * slots that are shared must hold the same attack set.
+ */
+static void init_magics(magic_t* magics,
+        const bitboard_t* magic_numbers,
+        bitboard_t* table,
+        bitboard_t (*slider_attacks)(int, bitboard_t))
+{
+    for (int index=0; index<64; ++index) {
+        magic_t* m = &magics[index];
+        // Pieces on the edge of the board never block anything, unless the
+        // slider is on that edge itself.
+        const bitboard_t edges =
+            ((RANK_1_BB | RANK_8_BB) & ~rank_mask[index/8]) |
+            ((FILE_A_BB | FILE_H_BB) & ~file_mask[index%8]);
+        m->mask = slider_attacks(index, EMPTY_BB) & ~edges;
+        m->magic = magic_numbers[index];
+        m->shift = 64 - pop_count(m->mask);
+        m->attacks = table;
+
+        // Enumerate every subset of the mask.
+        const int size = 1 << pop_count(m->mask);
+        for (int i=0; i<size; ++i) table[i] = EMPTY_BB;
+        bitboard_t subset = EMPTY_BB;
+        do {
+            const bitboard_t attacks = slider_attacks(index, subset);
+            bitboard_t* slot = &magic_attacks(*m, subset);
+            assert(*slot == EMPTY_BB || *slot == attacks);
+            *slot = attacks;
+            subset = (subset - m->mask) & m->mask;
+        } while (subset);
+        table += size;
+    }
+}
+
 /*
  * Set all static bitboards to their appropriate values.
  */
@@ -62,6 +322,11 @@ void init_bitboards(void)
         in_front_mask[WHITE][sq] &= file_mask[sq_file];
         in_front_mask[BLACK][sq] &= file_mask[sq_file];
     }
+    init_attack_tables();
+    init_magics(bishop_magics, bishop_magic_numbers,
+            bishop_attack_table, slow_bishop_attacks);
+    init_magics(rook_magics, rook_magic_numbers,
+            rook_attack_table, slow_rook_attacks);
 }
 
 /*
@@ -7,6 +7,16 @@ extern "C" {
 
 typedef uint64_t bitboard_t;
 
+// Magic bitboard lookup data for a single square. The attack set for a
+// slider is found by multiplying the relevant occupied squares by |magic|
+// and using the top bits of the result to index |attacks|.
+typedef struct {
+    bitboard_t mask;
+    bitboard_t magic;
+    bitboard_t* attacks;
+    int shift;
+} magic_t;
+
 #define BIT             0x1ull
 #define EMPTY_BB        0x0000000000000000ull
 #define FULL_BB         0xFFFFFFFFFFFFFFFFull
@@ -39,6 +49,15 @@ extern bitboard_t outpost_mask[2][64];
 extern bitboard_t passed_mask[2][64];
 extern const int bit_table[64];
 
+// Attack tables, indexed by bit index rather than 0x88 square.
+extern bitboard_t knight_attacks[64];
+extern bitboard_t king_attacks[64];
+extern bitboard_t pawn_attacks[2][64];
+extern bitboard_t between_mask[64][64];
+extern bitboard_t line_mask[64][64];
+extern magic_t bishop_magics[64];
+extern magic_t rook_magics[64];
+
 #define set_bit(bb, ind)        ((bb) |= set_mask[ind])
 #define set_sq_bit(bb, sq)      ((bb) |= set_mask[square_to_index(sq)])
 #define clear_bit(bb, ind)      ((bb) &= clear_mask[ind])
@@ -47,6 +66,20 @@ extern const int bit_table[64];
 #define sq_bit_is_set(bb, sq)   ((bb) & set_mask[square_to_index(sq)])
 #define first_bit(bb)           \
     (bit_table[(((bb) & (~(bb)+1)) * 0x0218A392CD3D5DBFull) >> 58])
+#define sq_bit(sq)              (set_mask[square_to_index(sq)])
+
+#define magic_attacks(m, occ)   \
+    ((m).attacks[(((occ) & (m).mask) * (m).magic) >> (m).shift])
+#define bishop_attacks(ind, occ)    magic_attacks(bishop_magics[ind], (occ))
+#define rook_attacks(ind, occ)      magic_attacks(rook_magics[ind], (occ))
+#define queen_attacks(ind, occ) \
+    (bishop_attacks((ind), (occ)) | rook_attacks((ind), (occ)))
+
+#if defined(__POPCNT__)
+#define pop_count(bb)           __builtin_popcountll(bb)
+#else
+#define pop_count(bb)           slow_pop_count(bb)
+#endif
 
 #ifdef __cplusplus
 }
@@ -103,6 +103,11 @@ extern const direction_t piece_deltas[17][16];
 
 extern const direction_t pawn_push[];
 extern const rank_t relative_rank[2][8];
+// Equivalent to the tables above, but these fold to constants when the
+// color is known at compile time.
+#define color_pawn_push(color)          ((color) == WHITE ? N : S)
+#define color_relative_rank(color, rank) \
+    ((color) == WHITE ? (rank_t)(rank) : (rank_t)(RANK_8 - (rank)))
 extern const piece_t flip_piece[16];
 
 extern square_t king_home;
@@ -4,7 +4,8 @@
 /*
  * Implementations of functions that don't exist on all platforms.
  * Right now this is just adding some string handling functions for
- * the Windows build and a standard 32-bit PRNG.
+ * the Windows build, a standard 32-bit PRNG, and allocation of large
+ * tables.
  */
 
 #ifdef _WIN32
@@ -140,3 +141,173 @@ int64_t random_64(void)
 }
 
 #endif
+
+#define HUGE_PAGE_BYTES     (2ull<<20)
+#define GIANT_PAGE_BYTES    (1ull<<30)
+#define round_up(x, n)      (((x) + (n) - 1) & ~((size_t)(n) - 1))
+
+#ifdef _WIN32
+
+/*
+ * Allocate |bytes| bytes of zeroed, page-aligned memory for a hash table.
+ * Large pages need the "lock pages in memory" privilege, so if we can't get
+ * them we just fall back to normal pages.
+ */
+bool alloc_table_memory(table_memory_t* mem, size_t bytes)
+{
+    SYSTEM_INFO info;
+    GetSystemInfo(&info);
+    size_t large_page = GetLargePageMinimum();
+    mem->base = NULL;
+    mem->transparent_huge_pages = false;
+    if (large_page && bytes >= large_page) {
+        mem->bytes = round_up(bytes, large_page);
+        mem->base = VirtualAlloc(NULL, mem->bytes,
+                MEM_RESERVE | MEM_COMMIT | MEM_LARGE_PAGES, PAGE_READWRITE);
+        mem->page_bytes = large_page;
+    }
+    if (!mem->base) {
+        mem->bytes = round_up(bytes, info.dwPageSize);
+        mem->base = VirtualAlloc(NULL, mem->bytes,
+                MEM_RESERVE | MEM_COMMIT, PAGE_READWRITE);
+        mem->page_bytes = info.dwPageSize;
+    }
+    return mem->base != NULL;
+}
+
+/*
+ * Release memory obtained from alloc_table_memory or map_table_file.
+ */
+void free_table_memory(table_memory_t* mem)
+{
+    if (mem->base) VirtualFree(mem->base, 0, MEM_RELEASE);
+    mem->base = NULL;
+}
+
+/*
+ * Fill |mem| with |bytes| bytes of |filename|, starting at |offset|. Private
+ * file mappings are awkward to resize and release on Windows, so we just
+ * read the data into freshly allocated table memory.
+ */
+bool map_table_file(table_memory_t* mem,
+        const char* filename,
+        size_t offset,
+        size_t bytes)
+{
+    FILE* file = fopen(filename, "rb");
+    if (!file) return false;
+    if (_fseeki64(file, offset, SEEK_SET) ||
+            !alloc_table_memory(mem, bytes)) {
+        fclose(file);
+        return false;
+    }
+    size_t done = 0;
+    while (done < bytes) {
+        size_t n = fread((char*)mem->base + done, 1,
+                MIN(bytes - done, (size_t)1<<30), file);
+        if (!n) break;
+        done += n;
+    }
+    fclose(file);
+    if (done < bytes) free_table_memory(mem);
+    return done == bytes;
+}
+
+#else
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#ifndef MAP_ANONYMOUS
+#define MAP_ANONYMOUS       MAP_ANON
+#endif
+#if defined(MAP_HUGETLB) && !defined(MAP_HUGE_1GB)
+#define MAP_HUGE_1GB        (30 << 26)
+#endif
+
+/*
+ * Map |bytes| bytes with the given extra flags, rounding the size up to a
+ * multiple of |page_bytes|.
+ */
+static bool map_table_memory(table_memory_t* mem,
+        size_t bytes,
+        size_t page_bytes,
+        int flags)
+{
+    mem->bytes = round_up(bytes, page_bytes);
+    mem->page_bytes = page_bytes;
+    mem->base = mmap(NULL, mem->bytes, PROT_READ | PROT_WRITE,
+            MAP_PRIVATE | MAP_ANONYMOUS | flags, -1, 0);
+    if (mem->base == MAP_FAILED) mem->base = NULL;
+    return mem->base != NULL;
+}
+
+/*
+ * Allocate |bytes| bytes of zeroed, page-aligned memory for a hash table.
+ * We try explicit 1GB and 2MB huge pages first. Those only work if the
+ * administrator has reserved some, so after that we fall back to normal
+ * pages and ask for transparent huge pages instead.
+ */
+bool alloc_table_memory(table_memory_t* mem, size_t bytes)
+{
+    mem->transparent_huge_pages = false;
+#ifdef MAP_HUGETLB
+    if (bytes >= GIANT_PAGE_BYTES && map_table_memory(mem,
+                bytes, GIANT_PAGE_BYTES, MAP_HUGETLB | MAP_HUGE_1GB)) {
+        return true;
+    }
+    if (bytes >= HUGE_PAGE_BYTES && map_table_memory(mem,
+                bytes, HUGE_PAGE_BYTES, MAP_HUGETLB)) {
+        return true;
+    }
+#endif
+    if (!map_table_memory(mem, bytes, sysconf(_SC_PAGESIZE), 0)) {
+        return false;
+    }
+#ifdef MADV_HUGEPAGE
+    if (bytes >= HUGE_PAGE_BYTES) {
+        mem->transparent_huge_pages =
+            !madvise(mem->base, mem->bytes, MADV_HUGEPAGE);
+    }
+#endif
+    return true;
+}
+
+/*
+ * Release memory obtained from alloc_table_memory or map_table_file.
+ */
+void free_table_memory(table_memory_t* mem)
+{
+    if (mem->base) munmap(mem->base, mem->bytes);
+    mem->base = NULL;
+}
+
+/*
+ * Map |bytes| bytes of |filename|, starting at |offset|, into memory. The
+ * mapping is private, so writes to the table never go back to the file, and
+ * pages are only read in as they're touched. |offset| must be a multiple of
+ * the page size.
+ */
+bool map_table_file(table_memory_t* mem,
+        const char* filename,
+        size_t offset,
+        size_t bytes)
+{
+    int fd = open(filename, O_RDONLY);
+    if (fd < 0) return false;
+    struct stat info;
+    if (fstat(fd, &info) || (size_t)info.st_size < offset + bytes) {
+        close(fd);
+        return false;
+    }
+    mem->bytes = bytes;
+    mem->page_bytes = sysconf(_SC_PAGESIZE);
+    mem->transparent_huge_pages = false;
+    mem->base = mmap(NULL, bytes, PROT_READ | PROT_WRITE, MAP_PRIVATE,
+            fd, offset);
+    close(fd);
+    if (mem->base == MAP_FAILED) mem->base = NULL;
+    return mem->base != NULL;
+}
+
+#endif
@@ -60,13 +60,48 @@ typedef __int16 int16_t;
 #   define  CACHE_ALIGN __attribute__ ((aligned(CACHE_LINE_BYTES)))
 #endif
 
+#if defined(_MSC_VER) || defined(__INTEL_COMPILER)
+#   define  NOINLINE __declspec(noinline)
+#else
+#   define  NOINLINE __attribute__ ((noinline))
+#endif
+
+// Hint that the cache line containing |addr| will be needed soon.
+#if defined(_MSC_VER) || defined(__INTEL_COMPILER)
+#   include <xmmintrin.h>
+#   define  prefetch(addr) _mm_prefetch((const char*)(addr), _MM_HINT_T0)
+#else
+#   define  prefetch(addr) __builtin_prefetch(addr)
+#endif
+
+// Read the processor's time stamp counter, for timing short stretches of
+// code. On current x86 chips this ticks at a fixed reference rate rather
+// than the actual core clock. Elsewhere we have no counter and read zero.
+#if defined(_MSC_VER)
+#   include <intrin.h>
+#   define  read_cycle_counter() ((uint64_t)__rdtsc())
+#elif defined(__i386__) || defined(__x86_64__)
+#   define  read_cycle_counter() ((uint64_t)__builtin_ia32_rdtsc())
+#else
+#   define  read_cycle_counter() ((uint64_t)0)
+#   define  NO_CYCLE_COUNTER
+#endif
+
 // Threading support
 #define	_REENTRANT
 #define _PTHREADS
 #define _POSIX_PTHREAD_SEMANTICS
+#ifdef _MSC_VER
+#   define  THREAD_LOCAL __declspec(thread)
+#   define  memory_barrier() MemoryBarrier()
+#else
+#   define  THREAD_LOCAL __thread
+#   define  memory_barrier() __sync_synchronize()
+#endif
 
 // 32 or 64 bit?
 #if defined(__x86_64) || \
+    defined(__LP64__) || \
     defined(_WIN64) || \
     (__SIZEOF_INT__ > 4) || \
     defined(_M_X64)
@@ -75,6 +110,16 @@ typedef __int16 int16_t;
 #   define ARCH_32_BIT
 #endif
 
+// Memory for the big hash tables. We ask the OS for huge pages where we can
+// get them, since TLB misses are a big cost once the tables get large.
+#include <stddef.h>
+typedef struct {
+    void* base;
+    size_t bytes;
+    size_t page_bytes;
+    bool transparent_huge_pages;
+} table_memory_t;
+
 // Endian-ness fixers. I provide my own versions to give support for 64-bit
 // types and to avoid the need to link in the winsock library on Windows.
 extern bool big_endian;
@@ -37,6 +37,8 @@ extern "C" {
 #include "search.h"
 #include "trans_table.h"
 #include "move_selection.h"
+#include "smp.h"
+#include "instrument.h"
 #include "debug.h"
 
 /*
@@ -48,15 +50,25 @@ void generate_attack_data(void);
 direction_t pin_direction(const position_t* pos,
         square_t from,
         square_t king_sq);
+bitboard_t attackers_to(const position_t* pos,
+        square_t sq,
+        bitboard_t occupied);
+bitboard_t piece_attacks(const position_t* pos,
+        square_t from,
+        bitboard_t occupied);
+bitboard_t pinned_pieces(const position_t* pos,
+        color_t side,
+        bitboard_t* pinners);
 bool is_square_attacked(const position_t* pos, square_t square, color_t side);
 bool piece_attacks_near(const position_t* pos, square_t from, square_t target);
 uint8_t find_checks(position_t* pos);
 
 // benchmark.c
-void benchmark(int depth, int time_limit);
+void benchmark(char* args);
 
 // bitboard.c
 void init_bitboards(void);
+int slow_pop_count(bitboard_t bb);
 void print_bitboard(bitboard_t bb);
 
 // book_poly.c
@@ -72,6 +84,12 @@ move_t get_ctg_book_move(position_t* pos);
 void srandom_32(unsigned seed);
 int32_t random_32(void);
 int64_t random_64(void);
+bool alloc_table_memory(table_memory_t* mem, size_t bytes);
+void free_table_memory(table_memory_t* mem);
+bool map_table_file(table_memory_t* mem,
+        const char* filename,
+        size_t offset,
+        size_t bytes);
 
 // daydreamer.c
 void init_daydreamer(void);
@@ -82,10 +100,21 @@ void unload_scorpio_bb(void);
 bool probe_scorpio_bb(position_t* pos, int* value, int ply);
 
 // epd.c
-void epd_testsuite(char* filename, int time_per_problem);
+char** read_epd_file(const char* filename, int* num_lines);
+void free_epd_file(char** lines, int num_lines);
+void epd_testsuite(char* filename,
+        int time_per_problem,
+        uint64_t nodes_per_problem,
+        int threads);
 
 // eval.c
 void init_eval(void);
+void init_eval_cache(const int max_bytes);
+void sync_eval_cache(void);
+void release_eval_cache(void);
+void clear_eval_cache(void);
+void prefetch_eval_cache(hashkey_t hash);
+void print_eval_cache_stats(void);
 int simple_eval(const position_t* pos);
 int full_eval(const position_t* pos, eval_data_t* ed);
 void report_eval(const position_t* pos);
@@ -98,8 +127,11 @@ score_t evaluate_king_safety(const position_t* pos, eval_data_t* ed);
 
 // eval_material.c
 void init_material_table(const int max_bytes);
+void sync_material_table(void);
+void release_material_table(void);
 void clear_material_table(void);
 material_data_t* get_material_data(const position_t* pos);
+void prefetch_material_data(hashkey_t material_hash);
 int game_phase(const position_t* pos);
 
 // eval_patterns.c
@@ -107,8 +139,11 @@ score_t pattern_score(const position_t*pos);
 
 // eval_pawns.c
 void init_pawn_table(const int max_bytes);
+void sync_pawn_table(void);
+void release_pawn_table(void);
 void clear_pawn_table(void);
 score_t pawn_score(const position_t* pos, pawn_data_t** pawn_data);
+void prefetch_pawn_data(hashkey_t pawn_hash);
 void print_pawn_stats(void);
 
 // eval_pieces.c
@@ -141,6 +176,19 @@ hashkey_t hash_pawns(const position_t* pos);
 hashkey_t hash_material(const position_t* pos);
 void set_hash(position_t* pos);
 
+// instrument.c
+void set_instrument_thread(int thread_id);
+void reset_instrumentation(void);
+void print_instrumentation(void);
+
+// legal_move_generation.c
+int generate_legal_moves(position_t* pos, move_t* moves);
+int generate_legal_tactical_moves(const position_t* pos, move_t* moves);
+int generate_legal_quiet_moves(const position_t* pos, move_t* moves);
+
+// microbench.c
+void microbench(char* args);
+
 // move.c
 void place_piece(position_t* position, piece_t piece, square_t square);
 void remove_piece(position_t* position, square_t square);
@@ -151,7 +199,8 @@ void do_nullmove(position_t* pos, undo_info_t* undo);
 void undo_nullmove(position_t* pos, undo_info_t* undo);
 
 // move_generation.c
-int generate_legal_moves(position_t* pos, move_t* moves);
+int generate_reference_legal_moves(position_t* pos, move_t* moves);
+int generate_pseudo_castles(const position_t* pos, move_t* moves);
 int generate_pseudo_moves(const position_t* position, move_t* move_list);
 int generate_pseudo_tactical_moves(const position_t* pos, move_t* moves);
 int generate_pseudo_quiet_moves(const position_t* pos, move_t* moves);
@@ -163,6 +212,7 @@ int generate_quiescence_moves(const position_t* pos,
 
 // move_selection.c
 void init_move_selector(move_selector_t* sel,
+        search_data_t* data,
         position_t* pos,
         generation_t gen_type,
         search_node_t* search_node,
@@ -190,11 +240,12 @@ void print_multipv(search_data_t* data);
 
 // perft.c
 void perft_testsuite(char* filename);
-uint64_t perft(position_t* position, int depth, bool divide);
+uint64_t perft(position_t* position, int depth, int threads, bool divide);
 
 // position.c
 char* set_position(position_t* pos, const char* fen);
 void copy_position(position_t* dst, const position_t* src);
+void attach_hash_history(position_t* pos, hash_history_t* history);
 void flip_position(position_t* flipped, const position_t* src);
 bool is_move_legal(position_t* pos, const move_t move);
 bool is_plausible_move_legal(position_t* pos, move_t move);
@@ -204,32 +255,58 @@ bool is_repetition(const position_t* pos);
 
 // search.c
 void init_search_data(search_data_t* data);
-void init_root_move(root_move_t* root_move, move_t move);
+void init_root_move(search_data_t* data, root_move_t* root_move, move_t move);
 bool should_stop_searching(search_data_t* data);
 void store_root_node_count(move_t move, uint64_t nodes);
 void deepening_search(search_data_t* search_data, bool ponder);
+void helper_deepening_search(search_data_t* data);
+void independent_search(search_data_t* data);
+void search_split_point(search_data_t* data, split_point_t* sp);
+
+// smp.c
+void init_threads(int threads);
+int get_num_threads(void);
+search_data_t* get_thread_data(int thread_id);
+void run_on_all_threads(thread_task_t task, void* arg);
+void start_helpers(search_data_t* data);
+void stop_helpers(void);
+uint64_t total_nodes_searched(const search_data_t* data);
+bool can_split(const search_data_t* data);
+bool split(search_data_t* data, split_point_t* sp);
+void wait_for_slaves(search_data_t* data, split_point_t* sp);
 
 // static_exchange_eval.c
 int static_exchange_eval(const position_t* pos, move_t move);
 int static_exchange_sign(const position_t* pos, move_t move);
+void clear_see_cache(void);
 
 // timer.c
 void init_timer(milli_timer_t* timer);
 void start_timer(milli_timer_t* timer);
 int stop_timer(milli_timer_t* timer);
 int elapsed_time(milli_timer_t* timer);
+uint64_t nanosecond_clock(void);
 
 // trans_table.c
 void init_transposition_table(const size_t max_bytes);
+void sync_transposition_table(void);
+void set_transposition_replacement(replacement_scheme_t scheme);
 void clear_transposition_table(void);
 void increment_transposition_age(void);
-transposition_entry_t* get_transposition(position_t* pos);
+void set_transposition_thread(int thread_id);
+void set_transposition_partition(int part, int num_parts);
+void clear_transposition_partition(void);
+void prefetch_transposition(hashkey_t hash);
+transposition_entry_t* get_transposition(position_t* pos,
+        transposition_entry_t* entry);
 void put_transposition(position_t* pos,
         move_t move,
         float depth,
         int score,
         score_type_t score_type,
         bool mate_threat);
+bool save_transposition_table(const char* filename);
+bool load_transposition_table(const char* filename);
 void put_transposition_line(position_t* pos,
         move_t* moves,
         float depth,
@@ -13,22 +13,30 @@ void _check_board_validity(const position_t* pos)
     assert(pos->num_pawns[BLACK] <= 8);
     int my_piece_count[16];
     memset(my_piece_count, 0, 16 * sizeof(int));
+    bitboard_t my_occupied_bb[2] = { EMPTY_BB, EMPTY_BB };
+    bitboard_t my_piece_bb[16];
+    memset(my_piece_bb, 0, 16 * sizeof(bitboard_t));
     for (square_t sq=A1; sq<=H8; ++sq) {
         if (!valid_board_index(sq) || !pos->board[sq]) continue;
         piece_t piece = pos->board[sq];
         color_t side = piece_color(piece);
         (void)side;
         my_piece_count[piece]++;
+        set_sq_bit(my_occupied_bb[side], sq);
+        set_sq_bit(my_piece_bb[piece], sq);
         if (piece_is_type(piece, PAWN)) {
             assert(pos->pawns[side][pos->piece_index[sq]] == sq);
         } else {
             assert(pos->pieces[side][pos->piece_index[sq]] == sq);
         }
     }
+    assert(my_occupied_bb[WHITE] == pos->occupied_bb[WHITE]);
+    assert(my_occupied_bb[BLACK] == pos->occupied_bb[BLACK]);
     assert(my_piece_count[WK] == 1);
     assert(my_piece_count[BK] == 1);
     for (int i=0; i<16; ++i) {
         assert(my_piece_count[i] == pos->piece_count[i]);
+        assert(my_piece_bb[i] == pos->piece_bb[i]);
     }
     for (int i=0; i<pos->num_pieces[0]; ++i) {
         assert(pos->piece_index[pos->pieces[0][i]] == i);
@@ -1,61 +1,283 @@
 #include "daydreamer.h"
+#include <ctype.h>
 #include <errno.h>
 #include <stdio.h>
 #include <string.h>
 
-void epd_testsuite(char* filename, int time_per_problem)
+#define MAX_EPD_MOVES   16
+
+// One test position from an epd file. A search result passes if it's one of
+// the best moves (when any are given) and none of the avoid moves. The acn
+// and acs opcodes override the node and time limits for this position.
+typedef struct {
+    char id[64];
+    move_t best_moves[MAX_EPD_MOVES + 1];
+    move_t avoid_moves[MAX_EPD_MOVES + 1];
+    uint64_t node_limit;
+    int time_limit;
+} epd_test_t;
+
+// Shared state for a test suite run. Threads take tests from |lines| in
+// order, and everything but the test lines is protected by |lock|.
+typedef struct {
+    char** lines;
+    int num_tests;
+    int next_test;
+    int time_per_problem;
+    uint64_t nodes_per_problem;
+    int correct_tests;
+    uint64_t total_nodes;
+    lock_t lock;
+} epd_run_t;
+
+/*
+ * Read the non-blank lines of |filename| into a newly allocated array, to
+ * be released with |free_epd_file|. Returns NULL if the file can't be read.
+ */
+char** read_epd_file(const char* filename, int* num_lines)
 {
-    char test_storage[4096];
-    char* test = test_storage;
-    milli_timer_t epd_timer;
-    init_timer(&epd_timer);
     FILE* test_file = fopen(filename, "r");
     if (!test_file) {
-        printf("Couldn't open epd test file %s: %s\n",
+        printf("Couldn't open epd file %s: %s\n",
                 filename, strerror(errno));
-        return;
+        return NULL;
     }
-    int total_tests = 0, correct_tests = 0;
-    while (fgets(test, 4096, test_file)) {
-        char *bm=NULL, *id=NULL, *token=NULL;
-        move_t best_move = NO_MOVE;
-        init_search_data(&root_data);
-        set_position(&root_data.root_pos, test);
-        print_board(&root_data.root_pos, false);
-        while ((token = strsep(&test, "; \t"))) {
-            if (!*token) continue;
-            if (strcasestr(token, "bm")) {
-                while (!bm || !*bm) bm = strsep(&test, "; \t");
-                best_move = san_str_to_move(&root_data.root_pos, bm);
-            }
-            if (strcasestr(token, "id")) {
-                strsep(&test, "\"");
-                id = strsep(&test, "\"");
+    char line[4096];
+    int capacity = 256;
+    char** lines = (char**)malloc(capacity * sizeof(char*));
+    *num_lines = 0;
+    while (fgets(line, 4096, test_file)) {
+        char* c = line;
+        while (*c) ++c;
+        while (c > line && isspace(*--c)) *c = '\0';
+        if (!*line) continue;
+        if (*num_lines == capacity) {
+            capacity *= 2;
+            lines = (char**)realloc(lines, capacity * sizeof(char*));
+        }
+        lines[*num_lines] = (char*)malloc(strlen(line) + 1);
+        strcpy(lines[(*num_lines)++], line);
+    }
+    fclose(test_file);
+    return lines;
+}
+
+/*
+ * Release the lines returned by |read_epd_file|.
+ */
+void free_epd_file(char** lines, int num_lines)
+{
+    for (int i=0; i<num_lines; ++i) free(lines[i]);
+    free(lines);
+}
+
+/*
+ * Read the list of san moves in |operands| into |moves|.
+ */
+static void parse_epd_moves(position_t* pos, char* operands, move_t* moves)
+{
+    int num_moves = 0;
+    char* san;
+    while ((san = strsep(&operands, " \t")) && num_moves < MAX_EPD_MOVES) {
+        if (!*san) continue;
+        move_t move = san_str_to_move(pos, san);
+        if (move != NO_MOVE) moves[num_moves++] = move;
+    }
+    moves[num_moves] = NO_MOVE;
+}
+
+/*
+ * Set up |pos| and |test| from the epd description in |line|, which is
+ * modified in the process. Returns false if the line doesn't give any best
+ * or avoid moves that are legal in the position.
+ */
+static bool parse_epd_test(char* line,
+        position_t* pos,
+        epd_test_t* test,
+        int time_per_problem,
+        uint64_t nodes_per_problem)
+{
+    memset(test, 0, sizeof(epd_test_t));
+    test->time_limit = time_per_problem;
+    test->node_limit = nodes_per_problem;
+    char* operations = set_position(pos, line);
+    char* operation;
+    while ((operation = strsep(&operations, ";"))) {
+        while (isspace(*operation)) ++operation;
+        char* opcode = strsep(&operation, " \t");
+        if (!operation) continue;
+        if (!strcasecmp(opcode, "bm")) {
+            parse_epd_moves(pos, operation, test->best_moves);
+        } else if (!strcasecmp(opcode, "am")) {
+            parse_epd_moves(pos, operation, test->avoid_moves);
+        } else if (!strcasecmp(opcode, "id")) {
+            strsep(&operation, "\"");
+            char* id = strsep(&operation, "\"");
+            if (id) snprintf(test->id, sizeof(test->id), "%s", id);
+        } else if (!strcasecmp(opcode, "acn")) {
+            sscanf(operation, "%"SCNu64, &test->node_limit);
+        } else if (!strcasecmp(opcode, "acs")) {
+            int seconds;
+            if (sscanf(operation, "%d", &seconds) == 1) {
+                test->time_limit = seconds * 1000;
             }
         }
-        printf("%d: %s\t", total_tests+1, id);
-        if (best_move == NO_MOVE) {
-            printf("parse error: couldn't read best move\n");
-            test = test_storage;
-            ++total_tests;
+    }
+    return test->best_moves[0] || test->avoid_moves[0];
+}
+
+/*
+ * Does playing |move| solve |test|? A search that didn't produce a move
+ * never does.
+ */
+static bool is_epd_solution(const epd_test_t* test, move_t move)
+{
+    if (move == NO_MOVE) return false;
+    for (const move_t* avoid = test->avoid_moves; *avoid; ++avoid) {
+        if (*avoid == move) return false;
+    }
+    if (!test->best_moves[0]) return true;
+    for (const move_t* best = test->best_moves; *best; ++best) {
+        if (*best == move) return true;
+    }
+    return false;
+}
+
+/*
+ * Print the outcome of test number |index|, played from |pos|.
+ */
+static void print_epd_result(int index,
+        const epd_test_t* test,
+        position_t* pos,
+        move_t result,
+        int time,
+        uint64_t nodes)
+{
+    char san[8] = "none";
+    if (result != NO_MOVE) move_to_san_str(pos, result, san);
+    printf("%d: %s\t%s %s / %.2fs %"PRIu64" nodes\n", index+1, test->id,
+            is_epd_solution(test, result) ? "OK" : "--", san,
+            time/1000.0, nodes);
+}
+
+/*
+ * Solve tests from |run| until there are none left, each with an
+ * independent search on its own slice of the hash table. Results are
+ * printed as soon as each test finishes. Run on every thread at once by
+ * |run_on_all_threads|.
+ */
+static void epd_worker(int thread_id, int num_threads, void* arg)
+{
+    epd_run_t* run = (epd_run_t*)arg;
+    search_data_t* data = (search_data_t*)malloc(sizeof(search_data_t));
+    memset(data, 0, sizeof(search_data_t));
+    set_position(&data->root_pos, FEN_STARTPOS);
+    set_transposition_partition(thread_id, num_threads);
+    while (true) {
+        lock_grab(run->lock);
+        int index = run->next_test++;
+        lock_release(run->lock);
+        if (index >= run->num_tests) break;
+
+        epd_test_t test;
+        init_search_data(data);
+        data->thread_id = thread_id;
+        bool valid = parse_epd_test(run->lines[index], &data->root_pos,
+                &test, run->time_per_problem, run->nodes_per_problem);
+        attach_hash_history(&data->root_pos, &data->hash_history);
+        if (!valid) {
+            lock_grab(run->lock);
+            printf("%d: %s\tparse error: couldn't read best move\n",
+                    index+1, test.id);
+            lock_release(run->lock);
+            continue;
+        }
+        data->time_target = data->time_limit = test.time_limit;
+        data->node_limit = test.node_limit;
+        clear_transposition_partition();
+        independent_search(data);
+
+        lock_grab(run->lock);
+        print_epd_result(index, &test, &data->root_pos, data->pv[0],
+                elapsed_time(&data->timer), data->nodes_searched);
+        if (is_epd_solution(&test, data->pv[0])) ++run->correct_tests;
+        run->total_nodes += data->nodes_searched;
+        lock_release(run->lock);
+    }
+    set_transposition_partition(0, 1);
+    free(data);
+}
+
+/*
+ * Solve each test in |run| in turn with the normal search of root_data,
+ * using all search threads on one position at a time.
+ */
+static void run_serial_epd(epd_run_t* run)
+{
+    for (int index=0; index<run->num_tests; ++index) {
+        epd_test_t test;
+        init_search_data(&root_data);
+        bool valid = parse_epd_test(run->lines[index], &root_data.root_pos,
+                &test, run->time_per_problem, run->nodes_per_problem);
+        attach_hash_history(&root_data.root_pos, &root_data.hash_history);
+        print_board(&root_data.root_pos, false);
+        if (!valid) {
+            printf("%d: %s\tparse error: couldn't read best move\n",
+                    index+1, test.id);
             continue;
         }
-        bool failure = false;
-        start_timer(&epd_timer);
-        root_data.time_target = root_data.time_limit = time_per_problem;
+        root_data.time_target = root_data.time_limit = test.time_limit;
+        root_data.node_limit = test.node_limit;
         deepening_search(&root_data, false);
-        move_t result = root_data.pv[0];
-        int time = stop_timer(&epd_timer);
-        if (result != best_move) {
-            failure = true;
-            printf("--");
-        } else printf("OK");
-        printf(" / %.2fs\n", time/1000.0);
-        ++total_tests;
-        if (!failure) ++correct_tests;
-        test = test_storage;
+        uint64_t nodes = total_nodes_searched(&root_data);
+        print_epd_result(index, &test, &root_data.root_pos, root_data.pv[0],
+                elapsed_time(&root_data.timer), nodes);
+        if (is_epd_solution(&test, root_data.pv[0])) ++run->correct_tests;
+        run->total_nodes += nodes;
     }
-    printf("Tests completed. %d/%d tests passed in %.2fs.\n",
-            correct_tests, total_tests, elapsed_time(&epd_timer)/1000.0);
 }
 
+/*
+ * Search each position in an epd file for |time_per_problem| milliseconds
+ * and/or |nodes_per_problem| nodes (zero means no limit), and count how many
+ * searches come up with a best move and avoid all the avoid moves. If
+ * |threads| is more than one, that many positions are searched at once,
+ * each by a single thread with its own slice of the hash table. Otherwise
+ * positions are searched one at a time using the normal search.
+ */
+void epd_testsuite(char* filename,
+        int time_per_problem,
+        uint64_t nodes_per_problem,
+        int threads)
+{
+    epd_run_t run;
+    memset(&run, 0, sizeof(epd_run_t));
+    run.lines = read_epd_file(filename, &run.num_tests);
+    if (!run.lines) return;
+    run.time_per_problem = time_per_problem;
+    run.nodes_per_problem = nodes_per_problem;
+
+    milli_timer_t epd_timer;
+    init_timer(&epd_timer);
+    start_timer(&epd_timer);
+    if (threads > 1) {
+        int saved_threads = get_num_threads();
+        if (threads != saved_threads) init_threads(threads);
+        sync_transposition_table();
+        increment_transposition_age();
+        clear_pv_cache();
+        lock_init(run.lock);
+        run_on_all_threads(epd_worker, &run);
+        lock_destroy(run.lock);
+        if (threads != saved_threads) init_threads(saved_threads);
+    } else {
+        run_serial_epd(&run);
+    }
+    int time = stop_timer(&epd_timer);
+
+    printf("Tests completed. %d/%d tests passed in %.2fs, "
+            "%"PRIu64" nodes, %"PRIu64" nps.\n",
+            run.correct_tests, run.num_tests, time/1000.0,
+            run.total_nodes, run.total_nodes * 1000 / MAX(time, 1));
+    free_epd_file(run.lines, run.num_tests);
+}
@@ -1,5 +1,6 @@
 
 #include "daydreamer.h"
+#include <string.h>
 
 #include "pst.inc"
 
@@ -10,6 +11,25 @@
 
 static const int tempo_bonus[2] = { 9, 2 };
 
+static int compute_full_eval(const position_t* pos, eval_data_t* ed);
+
+// Full evaluations are cached by position hash. Each entry packs the upper
+// 48 bits of the hash together with the 16-bit score into a single word, so
+// an entry can never be read half-written. Like the pawn and material
+// tables, each search thread has its own cache.
+typedef uint64_t eval_cache_entry_t;
+#define eval_cache_key_mask     (~(uint64_t)0xffff)
+
+static THREAD_LOCAL eval_cache_entry_t* eval_cache = NULL;
+static THREAD_LOCAL table_memory_t eval_cache_memory;
+static THREAD_LOCAL int num_buckets;
+static THREAD_LOCAL int local_cache_bytes;
+static int eval_cache_bytes;
+static THREAD_LOCAL struct {
+    int misses;
+    int hits;
+} eval_cache_stats;
+
 /*
  * Initialize all static evaluation data structures.
  */
@@ -35,6 +55,80 @@ void init_eval(void)
     }
 }
 
+/*
+ * Create an evaluation cache of the appropriate size.
+ */
+void init_eval_cache(const int max_bytes)
+{
+    assert(max_bytes >= 1024);
+    eval_cache_bytes = local_cache_bytes = max_bytes;
+    int size = sizeof(eval_cache_entry_t);
+    num_buckets = 1;
+    while (size <= max_bytes >> 1) {
+        size <<= 1;
+        num_buckets <<= 1;
+    }
+    free_table_memory(&eval_cache_memory);
+    bool allocated = alloc_table_memory(&eval_cache_memory, size);
+    assert(allocated);
+    (void)allocated;
+    eval_cache = (eval_cache_entry_t*)eval_cache_memory.base;
+    clear_eval_cache();
+}
+
+/*
+ * Make sure the calling thread's cache matches the most recently requested
+ * size, creating or resizing it if necessary.
+ */
+void sync_eval_cache(void)
+{
+    if (local_cache_bytes != eval_cache_bytes) {
+        init_eval_cache(eval_cache_bytes);
+    }
+}
+
+/*
+ * Free the calling thread's cache.
+ */
+void release_eval_cache(void)
+{
+    free_table_memory(&eval_cache_memory);
+    eval_cache = NULL;
+    local_cache_bytes = 0;
+}
+
+/*
+ * Wipe the entire cache.
+ */
+void clear_eval_cache(void)
+{
+    memset(eval_cache, 0, sizeof(eval_cache_entry_t) * num_buckets);
+    memset(&eval_cache_stats, 0, sizeof(eval_cache_stats));
+}
+
+/*
+ * Start loading the cache entry for |hash|, if this thread has a cache.
+ */
+void prefetch_eval_cache(hashkey_t hash)
+{
+    if (!eval_cache) return;
+    prefetch(&eval_cache[hash & (num_buckets - 1)]);
+}
+
+/*
+ * Print stats about the evaluation cache.
+ */
+void print_eval_cache_stats(void)
+{
+    printf("info string eval cache entries %d", num_buckets);
+    printf(" hits %d (%.2f%%)", eval_cache_stats.hits,
+            (float)eval_cache_stats.hits /
+            (eval_cache_stats.hits + eval_cache_stats.misses)*100.);
+    printf(" misses %d (%.2f%%)\n", eval_cache_stats.misses,
+            (float)eval_cache_stats.misses /
+            (eval_cache_stats.hits + eval_cache_stats.misses)*100.);
+}
+
 /*
  * Combine two scores, scaling |addend| by the given factor.
  */
@@ -88,9 +182,30 @@ int simple_eval(const position_t* pos)
 }
 
 /*
- * Do full, more expensive evaluation of the position.
+ * Do full, more expensive evaluation of the position. Scores are cached, and
+ * the contents of |ed| are only filled in when the score isn't found in the
+ * cache.
  */
 int full_eval(const position_t* pos, eval_data_t* ed)
+{
+    instrument_scope(TIMER_FULL_EVAL);
+    eval_cache_entry_t* entry = &eval_cache[pos->hash & (num_buckets - 1)];
+    eval_cache_entry_t cached = *entry;
+    if (!((cached ^ pos->hash) & eval_cache_key_mask)) {
+        eval_cache_stats.hits++;
+        instrument_count(COUNTER_EVAL_CACHE_HITS);
+        return (int16_t)(cached & 0xffff);
+    }
+    eval_cache_stats.misses++;
+    int score = compute_full_eval(pos, ed);
+    *entry = (pos->hash & eval_cache_key_mask) | (uint16_t)score;
+    return score;
+}
+
+/*
+ * Do the work of full_eval, bypassing the cache.
+ */
+static int compute_full_eval(const position_t* pos, eval_data_t* ed)
 {
     color_t side = pos->side_to_move;
     score_t phase_score, component_score;
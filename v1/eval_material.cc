@@ -2,11 +2,17 @@
 #include "daydreamer.h"
 #include <string.h>
 
-static material_data_t* material_table = NULL;
 static void compute_material_data(const position_t* pos, material_data_t* md);
 
-static int num_buckets;
-static struct {
+// Each search thread gets its own material table. The size requested at
+// startup is kept in |material_table_bytes| so that helper threads can
+// create tables of their own.
+static THREAD_LOCAL material_data_t* material_table = NULL;
+static THREAD_LOCAL table_memory_t material_table_memory;
+static THREAD_LOCAL int num_buckets;
+static THREAD_LOCAL int local_table_bytes;
+static int material_table_bytes;
+static THREAD_LOCAL struct {
     int misses;
     int hits;
     int occupied;
@@ -19,18 +25,42 @@ static struct {
 void init_material_table(const int max_bytes)
 {
     assert(max_bytes >= 1024);
+    material_table_bytes = local_table_bytes = max_bytes;
     int size = sizeof(material_data_t);
     num_buckets = 1;
     while (size <= max_bytes >> 1) {
         size <<= 1;
         num_buckets <<= 1;
     }
-    if (material_table != NULL) free(material_table);
-    material_table = (material_data_t*)malloc(size);
-    assert(material_table);
+    free_table_memory(&material_table_memory);
+    bool allocated = alloc_table_memory(&material_table_memory, size);
+    assert(allocated);
+    (void)allocated;
+    material_table = (material_data_t*)material_table_memory.base;
     clear_material_table();
 }
 
+/*
+ * Make sure the calling thread's table matches the most recently requested
+ * size, creating or resizing it if necessary.
+ */
+void sync_material_table(void)
+{
+    if (local_table_bytes != material_table_bytes) {
+        init_material_table(material_table_bytes);
+    }
+}
+
+/*
+ * Free the calling thread's table.
+ */
+void release_material_table(void)
+{
+    free_table_memory(&material_table_memory);
+    material_table = NULL;
+    local_table_bytes = 0;
+}
+
 /*
  * Wipe the entire table.
  */
@@ -40,12 +70,24 @@ void clear_material_table(void)
     memset(&material_hash_stats, 0, sizeof(material_hash_stats));
 }
 
+/*
+ * Start loading the table entry for |material_hash| into cache, so that it's
+ * ready by the time we evaluate the position. Threads that never set up
+ * their own table have nothing to load.
+ */
+void prefetch_material_data(hashkey_t material_hash)
+{
+    if (!material_table) return;
+    prefetch(&material_table[material_hash & (num_buckets - 1)]);
+}
+
 /*
  * Look up the material data for the given position.
  */
 material_data_t* get_material_data(const position_t* pos)
 {
-    material_data_t* md = &material_table[pos->material_hash % num_buckets];
+    material_data_t* md =
+        &material_table[pos->material_hash & (num_buckets - 1)];
     if (md->key == pos->material_hash) {
         material_hash_stats.hits++;
         return md;
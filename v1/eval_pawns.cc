@@ -72,9 +72,15 @@ static const int central_space[0x80] = {
     0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0
 };
 
-static pawn_data_t* pawn_table = NULL;
-static int num_buckets;
-static struct {
+// Each search thread gets its own pawn table. The size requested through the
+// uci interface is kept in |pawn_table_bytes| so that helper threads can
+// create tables of their own.
+static THREAD_LOCAL pawn_data_t* pawn_table = NULL;
+static THREAD_LOCAL table_memory_t pawn_table_memory;
+static THREAD_LOCAL int num_buckets;
+static THREAD_LOCAL int local_table_bytes;
+static int pawn_table_bytes;
+static THREAD_LOCAL struct {
     int misses;
     int hits;
     int occupied;
@@ -87,18 +93,43 @@ static struct {
 void init_pawn_table(const int max_bytes)
 {
     assert(max_bytes >= 1024);
+    pawn_table_bytes = local_table_bytes = max_bytes;
     int size = sizeof(pawn_data_t);
     num_buckets = 1;
     while (size <= max_bytes >> 1) {
         size <<= 1;
         num_buckets <<= 1;
     }
-    if (pawn_table != NULL) free(pawn_table);
-    pawn_table = (pawn_data_t*)malloc(size);
-    assert(pawn_table);
+    free_table_memory(&pawn_table_memory);
+    bool allocated = alloc_table_memory(&pawn_table_memory, size);
+    assert(allocated);
+    (void)allocated;
+    pawn_table = (pawn_data_t*)pawn_table_memory.base;
     clear_pawn_table();
 }
 
+/*
+ * Make sure the calling thread's table matches the most recently requested
+ * size, creating or resizing it if necessary.
+ */
+void sync_pawn_table(void)
+{
+    if (local_table_bytes != pawn_table_bytes) {
+        init_pawn_table(pawn_table_bytes);
+    }
+}
+
+/*
+ * Free the calling thread's table. Helper threads call this on their way
+ * out, since nobody else can get at their thread-local tables.
+ */
+void release_pawn_table(void)
+{
+    free_table_memory(&pawn_table_memory);
+    pawn_table = NULL;
+    local_table_bytes = 0;
+}
+
 /*
  * Wipe the entire table.
  */
@@ -108,12 +139,23 @@ void clear_pawn_table(void)
     memset(&pawn_hash_stats, 0, sizeof(pawn_hash_stats));
 }
 
+/*
+ * Start loading the table entry for |pawn_hash| into cache, so that it's
+ * ready by the time we evaluate the position. Threads that never set up
+ * their own table (perft workers, for example) have nothing to load.
+ */
+void prefetch_pawn_data(hashkey_t pawn_hash)
+{
+    if (!pawn_table) return;
+    prefetch(&pawn_table[pawn_hash & (num_buckets - 1)]);
+}
+
 /*
  * Look up the pawn data for the pawns in the given position.
  */
 static pawn_data_t* get_pawn_data(const position_t* pos)
 {
-    pawn_data_t* pd = &pawn_table[pos->pawn_hash % num_buckets];
+    pawn_data_t* pd = &pawn_table[pos->pawn_hash & (num_buckets - 1)];
     if (pd->key == pos->pawn_hash) pawn_hash_stats.hits++;
     else if (pd->key != 0) pawn_hash_stats.evictions++;
     else {
@@ -141,160 +183,170 @@ void print_pawn_stats(void)
 }
 
 /*
- * Identify and record the position of all passed pawns. Analyze pawn structure
- * features, such as isolated and doubled pawns, and assign a pawn structure
- * score (which does not account for passers). This information is stored in
- * the pawn hash table, to prevent re-computation.
+ * Fill in the outposts, passers and structure score for |color|'s pawns.
+ * Each color gets its own compiled copy, with pawn directions and relative
+ * ranks resolved at compile time.
  */
-pawn_data_t* analyze_pawns(const position_t* pos)
+template <color_t color>
+static void analyze_side_pawns(const position_t* pos, pawn_data_t* pd)
 {
-    pawn_data_t* pd = get_pawn_data(pos);
-    if (pd->key == pos->pawn_hash) return pd;
-
-    // Zero everything out and create pawn bitboards.
-    memset(pd, 0, sizeof(pawn_data_t));
-    pd->key = pos->pawn_hash;
     square_t sq, to;
-    for (color_t color=WHITE; color<=BLACK; ++color) {
-        for (int i=0; pos->pawns[color][i] != INVALID_SQUARE; ++i) {
-            set_sq_bit(pd->pawns_bb[color], pos->pawns[color][i]);
+    pd->num_passed[color] = 0;
+    const int push = color_pawn_push(color);
+    const piece_t pawn = create_piece(color, PAWN);
+    const piece_t opp_pawn = create_piece(color^1, PAWN);
+    bitboard_t our_pawns = pd->pawns_bb[color];
+    bitboard_t their_pawns = pd->pawns_bb[color^1];
+
+    for (int ind=0; ind<64; ++ind) {
+        // Fill in mask of outpost squares.
+        sq = index_to_square(ind);
+        if (!(outpost_mask[color][ind] & their_pawns)) {
+            set_bit(pd->outposts_bb[color], ind);
         }
-    }
+        if (pos->board[sq] != pawn) continue;
 
-    // Create outpost bitboard and analyze pawns.
-    for (color_t color=WHITE; color<=BLACK; ++color) {
-        pd->num_passed[color] = 0;
-        int push = pawn_push[color];
-        const piece_t pawn = create_piece(color, PAWN);
-        const piece_t opp_pawn = create_piece(color^1, PAWN);
-        bitboard_t our_pawns = pd->pawns_bb[color];
-        bitboard_t their_pawns = pd->pawns_bb[color^1];
+        file_t file = square_file(sq);
+        rank_t rank = square_rank(sq);
+        rank_t rrank = color_relative_rank(color, rank);
 
-        for (int ind=0; ind<64; ++ind) {
-            // Fill in mask of outpost squares.
-            sq = index_to_square(ind);
-            if (!(outpost_mask[color][ind] & their_pawns)) {
-                set_bit(pd->outposts_bb[color], ind);
+        // Passed pawns and passed pawn candidates.
+        bool passed = !(passed_mask[color][ind] & their_pawns);
+        if (passed) {
+            set_bit(pd->passed_bb[color], ind);
+            pd->passed[color][pd->num_passed[color]++] = sq;
+            pd->score[color].midgame += passed_bonus[0][rrank];
+            pd->score[color].endgame += passed_bonus[1][rrank];
+        } else {
+            // Candidate passed pawns (one enemy pawn one file away).
+            // TODO: this condition could be more sophisticated.
+            int blockers = 0;
+            for (to = sq + push;
+                    pos->board[to] != OUT_OF_BOUNDS; to += push) {
+                if (pos->board[to-1] == opp_pawn) ++blockers;
+                if (pos->board[to] == opp_pawn) blockers = 2;
+                if (pos->board[to+1] == opp_pawn) ++blockers;
             }
-            if (pos->board[sq] != pawn) continue;
-
-            file_t file = square_file(sq);
-            rank_t rank = square_rank(sq);
-            rank_t rrank = relative_rank[color][rank];
-
-            // Passed pawns and passed pawn candidates.
-            bool passed = !(passed_mask[color][ind] & their_pawns);
-            if (passed) {
-                set_bit(pd->passed_bb[color], ind);
-                pd->passed[color][pd->num_passed[color]++] = sq;
-                pd->score[color].midgame += passed_bonus[0][rrank];
-                pd->score[color].endgame += passed_bonus[1][rrank];
-            } else {
-                // Candidate passed pawns (one enemy pawn one file away).
-                // TODO: this condition could be more sophisticated.
-                int blockers = 0;
-                for (to = sq + push;
-                        pos->board[to] != OUT_OF_BOUNDS; to += push) {
-                    if (pos->board[to-1] == opp_pawn) ++blockers;
-                    if (pos->board[to] == opp_pawn) blockers = 2;
-                    if (pos->board[to+1] == opp_pawn) ++blockers;
-                }
-                if (blockers < 2) {
-                    pd->score[color].midgame += candidate_bonus[0][rrank];
-                    pd->score[color].endgame += candidate_bonus[1][rrank];
-                }
+            if (blockers < 2) {
+                pd->score[color].midgame += candidate_bonus[0][rrank];
+                pd->score[color].endgame += candidate_bonus[1][rrank];
             }
+        }
 
-            // Isolated pawns.
-            bool isolated = (neighbor_file_mask[file] & our_pawns) == 0;
-            bool open = (in_front_mask[color][ind] & their_pawns) == 0;
-            if (isolated) {
-                if (open) {
-                    pd->score[color].midgame -= open_isolation_penalty[0][file];
-                    pd->score[color].endgame -= open_isolation_penalty[1][file];
-                } else {
-                    pd->score[color].midgame -= isolation_penalty[0][file];
-                    pd->score[color].endgame -= isolation_penalty[1][file];
-                }
+        // Isolated pawns.
+        bool isolated = (neighbor_file_mask[file] & our_pawns) == 0;
+        bool open = (in_front_mask[color][ind] & their_pawns) == 0;
+        if (isolated) {
+            if (open) {
+                pd->score[color].midgame -= open_isolation_penalty[0][file];
+                pd->score[color].endgame -= open_isolation_penalty[1][file];
+            } else {
+                pd->score[color].midgame -= isolation_penalty[0][file];
+                pd->score[color].endgame -= isolation_penalty[1][file];
             }
+        }
 
-            // Pawn storm scores. Only used in opposite-castling positions.
-            int storm = 1.5*king_storm[sq ^ (0x70*color)];
-            if (storm && (passed_mask[color][ind] &
-                        (~file_mask[file]) & their_pawns)) storm += storm/2;
-            if (storm && open) storm += storm/2;
-            pd->kingside_storm[color] += storm;
-            storm = 1.5*queen_storm[sq ^ (0x70*color)];
-            if (storm && (passed_mask[color][ind] &
-                        (~file_mask[file]) & their_pawns)) storm += storm/2;
-            if (storm && open) storm += storm/2;
-            pd->queenside_storm[color] += storm;
+        // Pawn storm scores. Only used in opposite-castling positions.
+        int storm = 1.5*king_storm[sq ^ (0x70*color)];
+        if (storm && (passed_mask[color][ind] &
+                    (~file_mask[file]) & their_pawns)) storm += storm/2;
+        if (storm && open) storm += storm/2;
+        pd->kingside_storm[color] += storm;
+        storm = 1.5*queen_storm[sq ^ (0x70*color)];
+        if (storm && (passed_mask[color][ind] &
+                    (~file_mask[file]) & their_pawns)) storm += storm/2;
+        if (storm && open) storm += storm/2;
+        pd->queenside_storm[color] += storm;
 
-            // Doubled pawns.
-            bool doubled = (in_front_mask[color^1][ind] & our_pawns) != 0;
-            if (doubled) {
-                pd->score[color].midgame -= doubled_penalty[0][file];
-                pd->score[color].endgame -= doubled_penalty[1][file];
-            }
+        // Doubled pawns.
+        bool doubled = (in_front_mask[color^1][ind] & our_pawns) != 0;
+        if (doubled) {
+            pd->score[color].midgame -= doubled_penalty[0][file];
+            pd->score[color].endgame -= doubled_penalty[1][file];
+        }
 
-            // Connected pawns.
-            bool connected = neighbor_file_mask[file] & our_pawns &
-                (rank_mask[rank] | rank_mask[rank + (color == WHITE ? 1:-1)]);
-            if (connected) {
-                pd->score[color].midgame += connected_bonus[0];
-                pd->score[color].endgame += connected_bonus[1];
-            }
+        // Connected pawns.
+        bool connected = neighbor_file_mask[file] & our_pawns &
+            (rank_mask[rank] | rank_mask[rank + (color == WHITE ? 1:-1)]);
+        if (connected) {
+            pd->score[color].midgame += connected_bonus[0];
+            pd->score[color].endgame += connected_bonus[1];
+        }
 
-            // Space bonus for connected advanced central pawns.
-            if (connected) pd->score[color].midgame +=
-                central_space[sq ^ (0x70*color)];
+        // Space bonus for connected advanced central pawns.
+        if (connected) pd->score[color].midgame +=
+            central_space[sq ^ (0x70*color)];
 
-            // Backward pawns (unsupportable by pawns, can't advance).
-            // TODO: a simpler formulation would be nice.
-            if (!passed && !isolated && !connected &&
-                    pos->board[sq+push-1] != opp_pawn &&
-                    pos->board[sq+push+1] != opp_pawn) {
-                bool backward = true;
-                for (to = sq; pos->board[to] != OUT_OF_BOUNDS; to -= push) {
-                    if (pos->board[to-1] == pawn || pos->board[to+1] == pawn) {
+        // Backward pawns (unsupportable by pawns, can't advance).
+        // TODO: a simpler formulation would be nice.
+        if (!passed && !isolated && !connected &&
+                pos->board[sq+push-1] != opp_pawn &&
+                pos->board[sq+push+1] != opp_pawn) {
+            bool backward = true;
+            for (to = sq; pos->board[to] != OUT_OF_BOUNDS; to -= push) {
+                if (pos->board[to-1] == pawn || pos->board[to+1] == pawn) {
+                    backward = false;
+                    break;
+                }
+            }
+            if (backward) {
+                for (to = sq + 2*push; pos->board[to] != OUT_OF_BOUNDS;
+                        to += push) {
+                    if (pos->board[to-1] == opp_pawn ||
+                            pos->board[to+1] == opp_pawn) break;
+                    if (pos->board[to-1] == pawn ||
+                            pos->board[to+1] == pawn) {
                         backward = false;
                         break;
                     }
                 }
                 if (backward) {
-                    for (to = sq + 2*push; pos->board[to] != OUT_OF_BOUNDS;
-                            to += push) {
-                        if (pos->board[to-1] == opp_pawn ||
-                                pos->board[to+1] == opp_pawn) break;
-                        if (pos->board[to-1] == pawn ||
-                                pos->board[to+1] == pawn) {
-                            backward = false;
-                            break;
-                        }
-                    }
-                    if (backward) {
-                        pd->score[color].midgame -= backward_penalty[0][file];
-                        pd->score[color].endgame -= backward_penalty[1][file];
-                    }
+                    pd->score[color].midgame -= backward_penalty[0][file];
+                    pd->score[color].endgame -= backward_penalty[1][file];
                 }
             }
         }
+    }
 
-        // Penalty for multiple pawn islands.
-        int islands = 0;
-        bool on_island = false;
-        for (file_t f = FILE_A; f <= FILE_H; ++f) {
-            if (!file_is_half_open(pd, f, color)) {
-                if (!on_island) {
-                    on_island = true;
-                    islands++;
-                }
-            } else on_island = false;
+    // Penalty for multiple pawn islands.
+    int islands = 0;
+    bool on_island = false;
+    for (file_t f = FILE_A; f <= FILE_H; ++f) {
+        if (!file_is_half_open(pd, f, color)) {
+            if (!on_island) {
+                on_island = true;
+                islands++;
+            }
+        } else on_island = false;
+    }
+    if (islands) --islands;
+    pd->score[color].midgame -= 2 * islands;
+    pd->score[color].endgame -= 4 * islands;
+}
+
+/*
+ * Identify and record the position of all passed pawns. Analyze pawn structure
+ * features, such as isolated and doubled pawns, and assign a pawn structure
+ * score (which does not account for passers). This information is stored in
+ * the pawn hash table, to prevent re-computation.
+ */
+pawn_data_t* analyze_pawns(const position_t* pos)
+{
+    pawn_data_t* pd = get_pawn_data(pos);
+    if (pd->key == pos->pawn_hash) return pd;
+
+    // Zero everything out and create pawn bitboards.
+    memset(pd, 0, sizeof(pawn_data_t));
+    pd->key = pos->pawn_hash;
+    for (color_t color=WHITE; color<=BLACK; ++color) {
+        for (int i=0; pos->pawns[color][i] != INVALID_SQUARE; ++i) {
+            set_sq_bit(pd->pawns_bb[color], pos->pawns[color][i]);
         }
-        if (islands) --islands;
-        pd->score[color].midgame -= 2 * islands;
-        pd->score[color].endgame -= 4 * islands;
     }
+
+    // Create outpost bitboard and analyze pawns.
+    analyze_side_pawns<WHITE>(pos, pd);
+    analyze_side_pawns<BLACK>(pos, pd);
     return pd;
 }
 
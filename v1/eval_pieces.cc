@@ -24,11 +24,6 @@ static const int mobility_score_table[2][8][32] = {
     },
 };
 
-static const int color_table[2][17] = {
-    {1, 0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 1, 1, 0, 0}, // white
-    {1, 1, 1, 1, 1, 1, 1, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0}, // black
-};
-
 static const int knight_outpost[0x80] = {
     0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,
     0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,
@@ -61,16 +56,17 @@ static const int rook_half_open_file_bonus[2] = { 10, 10 };
  * defended by a friendly pawn and for being difficult to take with an
  * opponent's minor piece.
  */
+template <color_t side>
 static int outpost_score(const position_t* pos, square_t sq, piece_type_t type)
 {
-    color_t side = piece_color(pos->board[sq]);
+    assert(piece_color(pos->board[sq]) == side);
     int bonus = type == KNIGHT ? knight_outpost[sq ^ (0x70*side)] : bishop_outpost[sq ^ (0x70*side)];
     int score = bonus;
     if (bonus) {
         // An outpost is better when supported by pawns.
         piece_t our_pawn = create_piece(side, PAWN);
-        if (pos->board[sq - pawn_push[side] - 1] == our_pawn ||
-                pos->board[sq - pawn_push[side] + 1] == our_pawn) {
+        if (pos->board[sq - color_pawn_push(side) - 1] == our_pawn ||
+                pos->board[sq - color_pawn_push(side) + 1] == our_pawn) {
             score += bonus/2;
             // Even better if an opposing knight/bishop can't capture it.
             // TODO: take care of the case where there's one opposing bishop
@@ -89,125 +85,106 @@ static int outpost_score(const position_t* pos, square_t sq, piece_type_t type)
 }
 
 /*
- * Compute the number of squares each non-pawn, non-king piece could move to,
- * and assign a bonus or penalty accordingly. Also assign miscellaneous
- * bonuses based on outpost squares, open files, etc.
+ * Mobility and placement bonuses for the pieces of color |side|, from that
+ * side's point of view. Instantiated once per color so that the relative
+ * rank tests and outpost table offsets become constants.
  */
-score_t pieces_score(const position_t* pos, pawn_data_t* pd)
+template <color_t side>
+static score_t side_pieces_score(const position_t* pos,
+        pawn_data_t* pd,
+        bitboard_t occupied)
 {
-    score_t score;
-    int mid_score[2] = {0, 0};
-    int end_score[2] = {0, 0};
-    rank_t king_rank[2] = { relative_rank[WHITE]
-                                [square_rank(pos->pieces[WHITE][0])],
-                            relative_rank[BLACK]
-                                [square_rank(pos->pieces[BLACK][0])] };
-    color_t side;
-    for (side=WHITE; side<=BLACK; ++side) {
-        const int* mobile = color_table[side];
-        square_t from, to;
-        piece_t piece;
-        for (int i=1; pos->pieces[side][i] != INVALID_SQUARE; ++i) {
-            from = pos->pieces[side][i];
-            piece = pos->board[from];
-            piece_type_t type = piece_type(piece);
-            int ps = 0;
-            switch (type) {
-                case KNIGHT: {
-                    ps += mobile[pos->board[from-33]];
-                    ps += mobile[pos->board[from-31]];
-                    ps += mobile[pos->board[from-18]];
-                    ps += mobile[pos->board[from-14]];
-                    ps += mobile[pos->board[from+14]];
-                    ps += mobile[pos->board[from+18]];
-                    ps += mobile[pos->board[from+31]];
-                    ps += mobile[pos->board[from+33]];
-                    if (square_is_outpost(pd, from, side)) {
-                        int bonus = outpost_score(pos, from, KNIGHT);
-                        mid_score[side] += bonus;
-                        end_score[side] += bonus;
-                    }
-                    break;
+    score_t score = { 0, 0 };
+    const rank_t their_king_rank = color_relative_rank(side^1,
+            square_rank(pos->pieces[side^1][0]));
+    // A piece's mobility is the number of squares it attacks that
+    // aren't occupied by its own side.
+    const bitboard_t targets = ~pos->occupied_bb[side];
+    square_t from;
+    piece_t piece;
+    for (int i=1; pos->pieces[side][i] != INVALID_SQUARE; ++i) {
+        from = pos->pieces[side][i];
+        piece = pos->board[from];
+        const int index = square_to_index(from);
+        piece_type_t type = piece_type(piece);
+        int ps = 0;
+        switch (type) {
+            case KNIGHT: {
+                ps = pop_count(knight_attacks[index] & targets);
+                if (square_is_outpost(pd, from, side)) {
+                    int bonus = outpost_score<side>(pos, from, KNIGHT);
+                    score.midgame += bonus;
+                    score.endgame += bonus;
                 }
-                case BISHOP: {
-                    for (to=from-17; pos->board[to]==EMPTY; to-=17, ++ps) {}
-                    ps += mobile[pos->board[to]];
-                    for (to=from-15; pos->board[to]==EMPTY; to-=15, ++ps) {}
-                    ps += mobile[pos->board[to]];
-                    for (to=from+15; pos->board[to]==EMPTY; to+=15, ++ps) {}
-                    ps += mobile[pos->board[to]];
-                    for (to=from+17; pos->board[to]==EMPTY; to+=17, ++ps) {}
-                    ps += mobile[pos->board[to]];
-                    if (square_is_outpost(pd, from, side)) {
-                        int bonus = outpost_score(pos, from, BISHOP);
-                        mid_score[side] += bonus;
-                        end_score[side] += bonus;
-                    }
-                    break;
+                break;
+            }
+            case BISHOP: {
+                ps = pop_count(bishop_attacks(index, occupied) & targets);
+                if (square_is_outpost(pd, from, side)) {
+                    int bonus = outpost_score<side>(pos, from, BISHOP);
+                    score.midgame += bonus;
+                    score.endgame += bonus;
                 }
-                case ROOK: {
-                    for (to=from-16; pos->board[to]==EMPTY; to-=16, ++ps) {}
-                    ps += mobile[pos->board[to]];
-                    for (to=from-1; pos->board[to]==EMPTY; to-=1, ++ps) {}
-                    ps += mobile[pos->board[to]];
-                    for (to=from+1; pos->board[to]==EMPTY; to+=1, ++ps) {}
-                    ps += mobile[pos->board[to]];
-                    for (to=from+16; pos->board[to]==EMPTY; to+=16, ++ps) {}
-                    ps += mobile[pos->board[to]];
-                    int rrank = relative_rank[side][square_rank(from)];
-                    if (rrank == RANK_7 && king_rank[side^1] == RANK_8) {
-                        mid_score[side] += rook_on_7[0];
-                        end_score[side] += rook_on_7[1];
-                    }
-                    file_t file = square_file(from);
-                    if (file_is_half_open(pd, file, side)) {
-                        mid_score[side] += rook_half_open_file_bonus[0];
-                        end_score[side] += rook_half_open_file_bonus[1];
-                        if (file_is_half_open(pd, file, side^1)) {
-                            mid_score[side] += rook_open_file_bonus[0];
-                            end_score[side] += rook_open_file_bonus[1];
-                        }
-                    }
-                    break;
+                break;
+            }
+            case ROOK: {
+                ps = pop_count(rook_attacks(index, occupied) & targets);
+                int rrank = color_relative_rank(side, square_rank(from));
+                if (rrank == RANK_7 && their_king_rank == RANK_8) {
+                    score.midgame += rook_on_7[0];
+                    score.endgame += rook_on_7[1];
                 }
-                case QUEEN: {
-                    for (to=from-17; pos->board[to]==EMPTY; to-=17, ++ps) {}
-                    ps += mobile[pos->board[to]];
-                    for (to=from-15; pos->board[to]==EMPTY; to-=15, ++ps) {}
-                    ps += mobile[pos->board[to]];
-                    for (to=from+15; pos->board[to]==EMPTY; to+=15, ++ps) {}
-                    ps += mobile[pos->board[to]];
-                    for (to=from+17; pos->board[to]==EMPTY; to+=17, ++ps) {}
-                    ps += mobile[pos->board[to]];
-                    for (to=from-16; pos->board[to]==EMPTY; to-=16, ++ps) {}
-                    ps += mobile[pos->board[to]];
-                    for (to=from-1; pos->board[to]==EMPTY; to-=1, ++ps) {}
-                    ps += mobile[pos->board[to]];
-                    for (to=from+1; pos->board[to]==EMPTY; to+=1, ++ps) {}
-                    ps += mobile[pos->board[to]];
-                    for (to=from+16; pos->board[to]==EMPTY; to+=16, ++ps) {}
-                    ps += mobile[pos->board[to]];
-                    if (relative_rank[side][square_rank(from)] == RANK_7 &&
-                            king_rank[side^1] == RANK_8) {
-                        mid_score[side] += rook_on_7[0] / 2;
-                        end_score[side] += rook_on_7[1] / 2;
+                file_t file = square_file(from);
+                if (file_is_half_open(pd, file, side)) {
+                    score.midgame += rook_half_open_file_bonus[0];
+                    score.endgame += rook_half_open_file_bonus[1];
+                    if (file_is_half_open(pd, file, side^1)) {
+                        score.midgame += rook_open_file_bonus[0];
+                        score.endgame += rook_open_file_bonus[1];
                     }
-                    break;
                 }
-                case KING:
-                case PAWN:
-                case NONE:
-                default: {
-                    assert(false);
+                break;
+            }
+            case QUEEN: {
+                ps = pop_count(queen_attacks(index, occupied) & targets);
+                if (color_relative_rank(side, square_rank(from)) == RANK_7 &&
+                        their_king_rank == RANK_8) {
+                    score.midgame += rook_on_7[0] / 2;
+                    score.endgame += rook_on_7[1] / 2;
                 }
+                break;
+            }
+            case KING:
+            case PAWN:
+            case NONE:
+            default: {
+                assert(false);
             }
-            mid_score[side] += mobility_score_table[0][type][ps];
-            end_score[side] += mobility_score_table[1][type][ps];
         }
+        score.midgame += mobility_score_table[0][type][ps];
+        score.endgame += mobility_score_table[1][type][ps];
     }
-    side = pos->side_to_move;
-    score.midgame = mid_score[side] - mid_score[side^1];
-    score.endgame = end_score[side] - end_score[side^1];
     return score;
 }
 
+/*
+ * Compute the number of squares each non-pawn, non-king piece could move to,
+ * and assign a bonus or penalty accordingly. Also assign miscellaneous
+ * bonuses based on outpost squares, open files, etc.
+ */
+score_t pieces_score(const position_t* pos, pawn_data_t* pd)
+{
+    const bitboard_t occupied =
+        pos->occupied_bb[WHITE] | pos->occupied_bb[BLACK];
+    const score_t white = side_pieces_score<WHITE>(pos, pd, occupied);
+    const score_t black = side_pieces_score<BLACK>(pos, pd, occupied);
+    score_t score;
+    if (pos->side_to_move == WHITE) {
+        score.midgame = white.midgame - black.midgame;
+        score.endgame = white.endgame - black.endgame;
+    } else {
+        score.midgame = black.midgame - white.midgame;
+        score.endgame = black.endgame - white.endgame;
+    }
+    return score;
+}
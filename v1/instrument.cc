@@ -0,0 +1,151 @@
+
+#include "daydreamer.h"
+#include <stdio.h>
+#include <string.h>
+
+#ifdef INSTRUMENT
+
+static const char* counter_names[NUM_COUNTERS] = {
+    "moves made", "eval cache hits", "see cache hits", "hash table hits"
+};
+
+static const char* timer_names[NUM_TIMERS] = {
+    "full_eval", "static_exchange_eval", "get_transposition",
+    "put_transposition", "generate tactics", "generate quiets",
+    "generate evasions", "generate qsearch"
+};
+
+static const char* histogram_names[NUM_HISTOGRAMS] = {
+    "move list length", "hash hit depth"
+};
+
+static CACHE_ALIGN instrument_data_t thread_instruments[MAX_THREADS];
+THREAD_LOCAL instrument_data_t* instrument = &thread_instruments[0];
+static uint64_t reset_cycles = 0;
+
+/*
+ * Point the calling thread at its own set of counters.
+ */
+void set_instrument_thread(int thread_id)
+{
+    assert(thread_id >= 0 && thread_id < MAX_THREADS);
+    instrument = &thread_instruments[thread_id];
+}
+
+/*
+ * Zero all counters, timers and histograms on every thread. Shouldn't be
+ * called during a search.
+ */
+void reset_instrumentation(void)
+{
+    memset(thread_instruments, 0, sizeof(thread_instruments));
+    reset_cycles = read_cycle_counter();
+}
+
+/*
+ * Print the non-empty buckets of |histogram|, one per line.
+ */
+static void print_histogram(const uint64_t* histogram)
+{
+    uint64_t total = 0;
+    for (int i=0; i<INSTRUMENT_BUCKETS; ++i) total += histogram[i];
+    for (int i=0; i<INSTRUMENT_BUCKETS; ++i) {
+        if (!histogram[i]) continue;
+        uint64_t low = i ? 1ull << (i-1) : 0;
+        uint64_t high = i ? (1ull << (i-1)) * 2 - 1 : 0;
+        printf("    %12"PRIu64"-%-12"PRIu64" %14"PRIu64" %6.2f%%\n",
+                low, high, histogram[i], 100.0 * histogram[i] / total);
+    }
+}
+
+/*
+ * Print everything recorded since the last reset, summed over all threads,
+ * with a per thread breakdown of the counters. Timers nest (the pawn eval
+ * uses static exchange eval, for example), so their shares of the elapsed
+ * cycles can add up to more than 100%, as can the shares of a search with
+ * more than one thread. Shares are only shown after the first reset, since
+ * before that we don't know when recording started.
+ */
+void print_instrumentation(void)
+{
+    const int num_threads = get_num_threads();
+    instrument_data_t total;
+    memset(&total, 0, sizeof(instrument_data_t));
+    for (int t=0; t<num_threads; ++t) {
+        const instrument_data_t* data = &thread_instruments[t];
+        for (int i=0; i<NUM_COUNTERS; ++i) {
+            total.counters[i] += data->counters[i];
+        }
+        for (int i=0; i<NUM_TIMERS; ++i) {
+            total.timers[i].calls += data->timers[i].calls;
+            total.timers[i].cycles += data->timers[i].cycles;
+            for (int j=0; j<INSTRUMENT_BUCKETS; ++j) {
+                total.timers[i].histogram[j] += data->timers[i].histogram[j];
+            }
+        }
+        for (int i=0; i<NUM_HISTOGRAMS; ++i) {
+            for (int j=0; j<INSTRUMENT_BUCKETS; ++j) {
+                total.histograms[i][j] += data->histograms[i][j];
+            }
+        }
+    }
+    const uint64_t elapsed = reset_cycles ?
+        MAX(read_cycle_counter() - reset_cycles, 1) : 0;
+
+    if (elapsed) {
+        printf("instrumentation: %"PRIu64" cycles since reset, %d threads\n",
+                elapsed, num_threads);
+    } else {
+        printf("instrumentation: never reset, %d threads\n", num_threads);
+    }
+    printf("%-22s %14s %16s %12s %8s\n",
+            "timer", "calls", "cycles", "cycles/call", "share");
+    for (int i=0; i<NUM_TIMERS; ++i) {
+        const instrument_timing_t* timing = &total.timers[i];
+        printf("%-22s %14"PRIu64" %16"PRIu64" %12.1f",
+                timer_names[i], timing->calls, timing->cycles,
+                (double)timing->cycles / MAX(timing->calls, 1));
+        if (elapsed) printf(" %7.2f%%\n", 100.0 * timing->cycles / elapsed);
+        else printf(" %8s\n", "-");
+    }
+    printf("%-22s %14s", "counter", "total");
+    for (int t=0; num_threads > 1 && t<num_threads; ++t) {
+        char thread_name[32];
+        snprintf(thread_name, sizeof(thread_name), "thread %d", t);
+        printf(" %12s", thread_name);
+    }
+    printf("\n");
+    for (int i=0; i<NUM_COUNTERS; ++i) {
+        printf("%-22s %14"PRIu64, counter_names[i], total.counters[i]);
+        for (int t=0; num_threads > 1 && t<num_threads; ++t) {
+            printf(" %12"PRIu64, thread_instruments[t].counters[i]);
+        }
+        printf("\n");
+    }
+    for (int i=0; i<NUM_TIMERS; ++i) {
+        if (!total.timers[i].calls) continue;
+        printf("%s cycles per call:\n", timer_names[i]);
+        print_histogram(total.timers[i].histogram);
+    }
+    for (int i=0; i<NUM_HISTOGRAMS; ++i) {
+        printf("%s:\n", histogram_names[i]);
+        print_histogram(total.histograms[i]);
+    }
+}
+
+#else
+
+void set_instrument_thread(int thread_id)
+{
+    (void)thread_id;
+}
+
+void reset_instrumentation(void) {}
+
+void print_instrumentation(void)
+{
+    printf("instrumentation isn't compiled in, "
+            "build with \"make instrument\" to use it\n");
+}
+
+#endif
@@ -0,0 +1,106 @@
+
+#ifndef INSTRUMENT_H
+#define INSTRUMENT_H
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*
+ * Counters, cycle timers, and histograms for finding out where the search
+ * spends its time. They only exist when compiled with -DINSTRUMENT (see
+ * "make instrument"); otherwise every macro here expands to nothing, so
+ * normal builds pay nothing for them. Each thread records into its own
+ * copy, and the copies are summed by print_instrumentation.
+ */
+
+typedef enum {
+    COUNTER_MOVES_MADE,
+    COUNTER_EVAL_CACHE_HITS,
+    COUNTER_SEE_CACHE_HITS,
+    COUNTER_TT_HITS,
+    NUM_COUNTERS
+} instrument_counter_t;
+
+typedef enum {
+    TIMER_FULL_EVAL,
+    TIMER_SEE,
+    TIMER_TT_PROBE,
+    TIMER_TT_STORE,
+    TIMER_GEN_TACTICS,
+    TIMER_GEN_QUIETS,
+    TIMER_GEN_EVASIONS,
+    TIMER_GEN_QSEARCH,
+    NUM_TIMERS
+} instrument_timer_t;
+
+typedef enum {
+    HISTOGRAM_MOVE_LIST_LENGTH,
+    HISTOGRAM_TT_HIT_DEPTH,
+    NUM_HISTOGRAMS
+} instrument_histogram_t;
+
+// Histogram bucket 0 counts zeros, and bucket n counts values in
+// [2^(n-1), 2^n).
+#define INSTRUMENT_BUCKETS  65
+
+typedef struct {
+    uint64_t calls;
+    uint64_t cycles;
+    uint64_t histogram[INSTRUMENT_BUCKETS];
+} instrument_timing_t;
+
+typedef struct {
+    uint64_t counters[NUM_COUNTERS];
+    instrument_timing_t timers[NUM_TIMERS];
+    uint64_t histograms[NUM_HISTOGRAMS][INSTRUMENT_BUCKETS];
+} instrument_data_t;
+
+#ifdef INSTRUMENT
+
+extern THREAD_LOCAL instrument_data_t* instrument;
+
+#if defined(_MSC_VER)
+static inline int instrument_bucket(uint64_t x)
+{
+    unsigned long index;
+    return _BitScanReverse64(&index, x) ? index + 1 : 0;
+}
+#else
+#define instrument_bucket(x)    \
+    ((x) ? 64 - __builtin_clzll((uint64_t)(x)) : 0)
+#endif
+
+// Times the rest of the enclosing block, adding the cycles it took to
+// |timer| when the block is left by any route.
+typedef struct instrument_scope_s {
+    instrument_timer_t timer;
+    uint64_t start;
+    instrument_scope_s(instrument_timer_t t) :
+        timer(t), start(read_cycle_counter()) {}
+    ~instrument_scope_s() {
+        uint64_t cycles = read_cycle_counter() - start;
+        instrument_timing_t* timing = &instrument->timers[timer];
+        timing->calls++;
+        timing->cycles += cycles;
+        timing->histogram[instrument_bucket(cycles)]++;
+    }
+} instrument_scope_t;
+
+#define instrument_count(counter)   (instrument->counters[counter]++)
+#define instrument_histogram(histogram, value)  \
+    (instrument->histograms[histogram][instrument_bucket(value)]++)
+#define instrument_scope(timer)     \
+    instrument_scope_t instrument_scope_##timer(timer)
+
+#else
+
+#define instrument_count(counter)
+#define instrument_histogram(histogram, value)
+#define instrument_scope(timer)
+
+#endif
+
+#ifdef __cplusplus
+} // extern "C"
+#endif
+#endif // INSTRUMENT_H
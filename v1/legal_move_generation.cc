@@ -0,0 +1,268 @@
+
+#include "daydreamer.h"
+#include <string.h>
+
+/*
+ * Fully legal move generation using bitboards. The generator in
+ * move_generation.cc produces pseudo-legal moves that have to be tested one
+ * at a time before they can be played. Here, checks and pins are worked out
+ * once for the whole position, and every move that comes out is legal.
+ */
+
+typedef enum {
+    LEGAL_TACTICS=0x01, LEGAL_QUIETS=0x02, LEGAL_ALL=0x03
+} legal_gen_t;
+
+typedef struct {
+    bitboard_t occupied;
+    bitboard_t us;
+    bitboard_t them;
+    bitboard_t pinned;
+    bitboard_t target;
+    int king_index;
+} legal_gen_data_t;
+
+/*
+ * Push a legal move onto the move list.
+ */
+static move_t* add_legal_move(const position_t* pos, move_t move, move_t* moves)
+{
+    (void)pos; // avoid warning when NDEBUG is defined
+    check_move_validity(pos, move);
+    *(moves++) = move;
+    return moves;
+}
+
+/*
+ * Work out which of our pieces are pinned and which squares a non-king move
+ * has to land on to deal with any check. The checking piece was already
+ * found by |find_checks| when the last move was made.
+ */
+static void init_legal_gen_data(const position_t* pos, legal_gen_data_t* gd)
+{
+    const color_t side = pos->side_to_move;
+    memset(gd, 0, sizeof(legal_gen_data_t));
+    gd->us = pos->occupied_bb[side];
+    gd->them = pos->occupied_bb[flip_color(side)];
+    gd->occupied = gd->us | gd->them;
+    gd->king_index = square_to_index(pos->pieces[side][0]);
+    gd->pinned = pinned_pieces(pos, side, NULL);
+
+    const int king = gd->king_index;
+    if (!pos->is_check) {
+        gd->target = FULL_BB;
+    } else if (pos->is_check > 1) {
+        gd->target = EMPTY_BB;
+    } else {
+        const int checker = square_to_index(pos->check_square);
+        gd->target = between_mask[king][checker] | set_mask[checker];
+    }
+}
+
+/*
+ * Add a pawn move to |to|, expanding it into all four promotions if the pawn
+ * is reaching the last rank.
+ */
+static move_t* add_pawn_move(const position_t* pos,
+        square_t from,
+        square_t to,
+        piece_t piece,
+        piece_t capture,
+        bool promote,
+        move_t* moves)
+{
+    if (!promote) {
+        return add_legal_move(pos,
+                create_move(from, to, piece, capture), moves);
+    }
+    for (piece_type_t type=KNIGHT; type<=QUEEN; ++type) {
+        moves = add_legal_move(pos,
+                create_move_promote(from, to, piece, capture, type), moves);
+    }
+    return moves;
+}
+
+/*
+ * Add all legal moves of the types given by |gen|. Captures, promotions,
+ * and en passant captures count as tactics; everything else is quiet.
+ * Both the side to move and |gen| are template parameters, so each of the
+ * six versions only contains the tests that apply to it.
+ */
+template <color_t side, int gen>
+static int generate_legal(const position_t* pos, move_t* moves)
+{
+    assert(pos->side_to_move == side);
+    move_t* moves_head = moves;
+    legal_gen_data_t gd;
+    init_legal_gen_data(pos, &gd);
+    const int king = gd.king_index;
+    const bitboard_t empty = ~gd.occupied;
+
+    // King moves. The king can't hide behind itself, so take it off the
+    // board before looking for attacks on its destination.
+    const square_t king_sq = pos->pieces[side][0];
+    const piece_t king_piece = create_piece(side, KING);
+    bitboard_t king_targets = king_attacks[king] & ~gd.us;
+    if (!(gen & LEGAL_TACTICS)) king_targets &= empty;
+    if (!(gen & LEGAL_QUIETS)) king_targets &= gd.them;
+    const bitboard_t no_king = gd.occupied ^ set_mask[king];
+    while (king_targets) {
+        const int to_index = first_bit(king_targets);
+        king_targets &= king_targets - 1;
+        const square_t to = index_to_square(to_index);
+        if (attackers_to(pos, to, no_king) & gd.them) continue;
+        moves = add_legal_move(pos,
+                create_move(king_sq, to, king_piece, pos->board[to]), moves);
+    }
+    // In double check, only king moves are possible.
+    if (!gd.target) {
+        *moves = 0;
+        return moves-moves_head;
+    }
+
+    // Castling is only possible when we're not in check. The pseudo-legal
+    // generator already handles all the Chess960 subtleties.
+    if ((gen & LEGAL_QUIETS) && gd.target == FULL_BB && can_castle(pos, side)) {
+        move_t castles[4];
+        generate_pseudo_castles(pos, castles);
+        for (move_t* castle=castles; *castle; ++castle) {
+            if (!is_pseudo_move_legal((position_t*)pos, *castle)) continue;
+            moves = add_legal_move(pos, *castle, moves);
+        }
+    }
+
+    // Knights and sliders.
+    bitboard_t move_mask = gd.target & ~gd.us;
+    if (!(gen & LEGAL_TACTICS)) move_mask &= empty;
+    if (!(gen & LEGAL_QUIETS)) move_mask &= gd.them;
+    for (int i=1; i<pos->num_pieces[side]; ++i) {
+        const square_t from = pos->pieces[side][i];
+        const int from_index = square_to_index(from);
+        const piece_t piece = pos->board[from];
+        bitboard_t targets;
+        switch (piece_type(piece)) {
+            case KNIGHT:
+                targets = knight_attacks[from_index]; break;
+            case BISHOP:
+                targets = bishop_attacks(from_index, gd.occupied); break;
+            case ROOK:
+                targets = rook_attacks(from_index, gd.occupied); break;
+            case QUEEN:
+                targets = queen_attacks(from_index, gd.occupied); break;
+            default: assert(false); targets = EMPTY_BB;
+        }
+        targets &= move_mask;
+        if (gd.pinned & set_mask[from_index]) {
+            targets &= line_mask[king][from_index];
+        }
+        while (targets) {
+            const int to_index = first_bit(targets);
+            targets &= targets - 1;
+            const square_t to = index_to_square(to_index);
+            moves = add_legal_move(pos,
+                    create_move(from, to, piece, pos->board[to]), moves);
+        }
+    }
+
+    // Pawns.
+    const piece_t pawn = create_piece(side, PAWN);
+    const direction_t push = color_pawn_push(side);
+    for (int i=0; i<pos->num_pawns[side]; ++i) {
+        const square_t from = pos->pawns[side][i];
+        const int from_index = square_to_index(from);
+        const rank_t rank = color_relative_rank(side, square_rank(from));
+        const bool promote = rank == RANK_7;
+        bitboard_t allowed = gd.target;
+        if (gd.pinned & set_mask[from_index]) {
+            allowed &= line_mask[king][from_index];
+        }
+
+        if (gen & LEGAL_TACTICS) {
+            bitboard_t captures =
+                pawn_attacks[side][from_index] & gd.them & allowed;
+            while (captures) {
+                const int to_index = first_bit(captures);
+                captures &= captures - 1;
+                const square_t to = index_to_square(to_index);
+                moves = add_pawn_move(pos, from, to, pawn,
+                        pos->board[to], promote, moves);
+            }
+
+            // En passant can uncover an attack on the king along the rank
+            // of the captured pawn, so test it directly.
+            const square_t ep = pos->ep_square;
+            if (ep != EMPTY && pos->board[ep] == EMPTY &&
+                    (pawn_attacks[side][from_index] & sq_bit(ep))) {
+                const square_t victim_sq = ep - push;
+                const bitboard_t victim = sq_bit(victim_sq);
+                const bitboard_t occupied =
+                    (gd.occupied ^ set_mask[from_index] ^ victim) | sq_bit(ep);
+                if (!(attackers_to(pos, king_sq, occupied) &
+                            gd.them & ~victim)) {
+                    moves = add_legal_move(pos,
+                            create_move_enpassant(from, ep, pawn,
+                                pos->board[victim_sq]),
+                            moves);
+                }
+            }
+        }
+
+        const square_t to = from + push;
+        if (pos->board[to] != EMPTY) continue;
+        if (promote) {
+            if ((gen & LEGAL_TACTICS) && (sq_bit(to) & allowed)) {
+                moves = add_pawn_move(pos, from, to, pawn,
+                        EMPTY, true, moves);
+            }
+            continue;
+        }
+        if (!(gen & LEGAL_QUIETS)) continue;
+        if (sq_bit(to) & allowed) {
+            moves = add_legal_move(pos,
+                    create_move(from, to, pawn, EMPTY), moves);
+        }
+        if (rank == RANK_2 && pos->board[to + push] == EMPTY &&
+                (sq_bit(to + push) & allowed)) {
+            moves = add_legal_move(pos,
+                    create_move(from, to + push, pawn, EMPTY), moves);
+        }
+    }
+
+    *moves = 0;
+    return moves-moves_head;
+}
+
+/*
+ * Fill the provided list with all legal moves in the given position.
+ */
+int generate_legal_moves(position_t* pos, move_t* moves)
+{
+    if (pos->side_to_move == WHITE) {
+        return generate_legal<WHITE, LEGAL_ALL>(pos, moves);
+    }
+    return generate_legal<BLACK, LEGAL_ALL>(pos, moves);
+}
+
+/*
+ * Generate all legal captures and promotions.
+ */
+int generate_legal_tactical_moves(const position_t* pos, move_t* moves)
+{
+    instrument_scope(TIMER_GEN_TACTICS);
+    if (pos->side_to_move == WHITE) {
+        return generate_legal<WHITE, LEGAL_TACTICS>(pos, moves);
+    }
+    return generate_legal<BLACK, LEGAL_TACTICS>(pos, moves);
+}
+
+/*
+ * Generate all legal moves which are neither captures nor promotions.
+ */
+int generate_legal_quiet_moves(const position_t* pos, move_t* moves)
+{
+    instrument_scope(TIMER_GEN_QUIETS);
+    if (pos->side_to_move == WHITE) {
+        return generate_legal<WHITE, LEGAL_QUIETS>(pos, moves);
+    }
+    return generate_legal<BLACK, LEGAL_QUIETS>(pos, moves);
+}
@@ -0,0 +1,378 @@
+
+#include "daydreamer.h"
+#include <ctype.h>
+#include <string.h>
+
+/*
+ * Timing for individual engine primitives, away from the noise of a full
+ * search. Each primitive is run over a fixed corpus of positions, reached by
+ * random games from the bench positions with a fixed seed, so the corpus is
+ * the same from run to run and machine to machine. After one untimed pass
+ * to warm up the caches and branch predictors, passes are repeated until
+ * enough time has gone by, and we report the mean time per call in
+ * nanoseconds and time stamp counter cycles, along with the fastest pass.
+ */
+
+#define MICROBENCH_POSITIONS    4096
+#define MICROBENCH_TIME         500
+#define MICROBENCH_WALK_PLIES   64
+
+extern const char* positions[];
+
+// The positions to run over, with their legal moves, captures and
+// pseudo-legal moves stored back to back. The moves for position i run from
+// offset[i] to offset[i+1] in each list. Every position shares one hash
+// history, which is fine because moves are always undone right away.
+typedef struct {
+    position_t* positions;
+    int num_positions;
+    int num_checks;
+    move_t* legal_moves;
+    int* legal_offset;
+    move_t* captures;
+    int* capture_offset;
+    move_t* pseudo_moves;
+    int* pseudo_offset;
+    hash_history_t history;
+} microbench_corpus_t;
+
+// One primitive to time. |run| makes one pass over the corpus and returns
+// the number of calls made, folding the results into |sink| so that the
+// compiler can't throw the calls away. |reset|, if given, is called before
+// each pass, outside the timed region.
+typedef uint64_t (*microbench_fn)(microbench_corpus_t* corpus, uint64_t* sink);
+typedef struct {
+    const char* name;
+    microbench_fn run;
+    void (*reset)(void);
+} microbench_t;
+
+/*
+ * A small self-contained generator, so that the corpus doesn't depend on
+ * the platform's random().
+ */
+static uint64_t next_random(uint64_t* state)
+{
+    *state ^= *state << 13;
+    *state ^= *state >> 7;
+    *state ^= *state << 17;
+    return *state;
+}
+
+/*
+ * Store the moves of every corpus position in a flat list, using |generate|
+ * to produce them. If |captures_only| is set, non-captures are dropped.
+ */
+static void fill_move_lists(microbench_corpus_t* corpus,
+        int (*generate)(position_t* pos, move_t* moves),
+        bool captures_only,
+        move_t** list,
+        int** offset)
+{
+    int capacity = corpus->num_positions * 64;
+    *list = (move_t*)malloc(capacity * sizeof(move_t));
+    *offset = (int*)malloc((corpus->num_positions + 1) * sizeof(int));
+    int total = 0;
+    for (int i=0; i<corpus->num_positions; ++i) {
+        move_t moves[256];
+        int num_moves = generate(&corpus->positions[i], moves);
+        if (total + num_moves > capacity) {
+            capacity = 2 * capacity + num_moves;
+            *list = (move_t*)realloc(*list, capacity * sizeof(move_t));
+        }
+        (*offset)[i] = total;
+        for (int j=0; j<num_moves; ++j) {
+            if (captures_only && !get_move_capture(moves[j])) continue;
+            (*list)[total++] = moves[j];
+        }
+    }
+    (*offset)[corpus->num_positions] = total;
+}
+
+static int pseudo_move_generator(position_t* pos, move_t* moves)
+{
+    return generate_pseudo_moves(pos, moves);
+}
+
+/*
+ * Build a corpus of |num_positions| positions by playing random legal moves
+ * from each bench position in turn. Checks are rare in random games, so we
+ * set aside an eighth of the corpus for positions in check to make sure the
+ * evasion generator has something to work on.
+ */
+static void init_corpus(microbench_corpus_t* corpus, int num_positions)
+{
+    memset(corpus, 0, sizeof(microbench_corpus_t));
+    corpus->positions =
+        (position_t*)malloc(num_positions * sizeof(position_t));
+    const int check_target = num_positions / 8;
+    int num_seeds = 0;
+    while (positions[num_seeds]) ++num_seeds;
+
+    uint64_t random_state = 0x9e3779b97f4a7c15ull;
+    position_t pos;
+    undo_info_t undo;
+    int count = 0;
+    for (int walk=0; count < num_positions; ++walk) {
+        set_position(&pos, positions[walk % num_seeds]);
+        attach_hash_history(&pos, &corpus->history);
+        for (int ply=0; ply<MICROBENCH_WALK_PLIES &&
+                count < num_positions; ++ply) {
+            move_t moves[256];
+            int num_moves = generate_legal_moves(&pos, moves);
+            if (!num_moves || is_draw(&pos)) break;
+            move_t move = moves[next_random(&random_state) % num_moves];
+            do_move(&pos, move, &undo);
+            // If checks are somehow too hard to come by, settle for
+            // whatever positions we get rather than walking forever.
+            bool checks_wanted = corpus->num_checks < check_target;
+            bool others_wanted =
+                count - corpus->num_checks < num_positions - check_target;
+            bool give_up = walk > 4 * num_positions;
+            if ((pos.is_check ? checks_wanted : others_wanted) || give_up) {
+                copy_position(&corpus->positions[count++], &pos);
+                if (pos.is_check) corpus->num_checks++;
+            }
+        }
+    }
+    corpus->num_positions = count;
+    fill_move_lists(corpus, generate_legal_moves, false,
+            &corpus->legal_moves, &corpus->legal_offset);
+    fill_move_lists(corpus, generate_legal_moves, true,
+            &corpus->captures, &corpus->capture_offset);
+    fill_move_lists(corpus, pseudo_move_generator, false,
+            &corpus->pseudo_moves, &corpus->pseudo_offset);
+}
+
+static void free_corpus(microbench_corpus_t* corpus)
+{
+    free(corpus->positions);
+    free(corpus->legal_moves);
+    free(corpus->legal_offset);
+    free(corpus->captures);
+    free(corpus->capture_offset);
+    free(corpus->pseudo_moves);
+    free(corpus->pseudo_offset);
+}
+
+static uint64_t bench_do_undo(microbench_corpus_t* corpus, uint64_t* sink)
+{
+    undo_info_t undo;
+    for (int i=0; i<corpus->num_positions; ++i) {
+        position_t* pos = &corpus->positions[i];
+        for (int j=corpus->legal_offset[i]; j<corpus->legal_offset[i+1]; ++j) {
+            do_move(pos, corpus->legal_moves[j], &undo);
+            *sink += pos->hash;
+            undo_move(pos, corpus->legal_moves[j], &undo);
+        }
+    }
+    return corpus->legal_offset[corpus->num_positions];
+}
+
+static uint64_t bench_pseudo_moves(microbench_corpus_t* corpus, uint64_t* sink)
+{
+    move_t moves[256];
+    uint64_t calls = 0;
+    for (int i=0; i<corpus->num_positions; ++i) {
+        if (corpus->positions[i].is_check) continue;
+        *sink += generate_pseudo_moves(&corpus->positions[i], moves);
+        ++calls;
+    }
+    return calls;
+}
+
+static uint64_t bench_evasions(microbench_corpus_t* corpus, uint64_t* sink)
+{
+    move_t moves[256];
+    uint64_t calls = 0;
+    for (int i=0; i<corpus->num_positions; ++i) {
+        if (!corpus->positions[i].is_check) continue;
+        *sink += generate_evasions(&corpus->positions[i], moves);
+        ++calls;
+    }
+    return calls;
+}
+
+static uint64_t bench_pseudo_legal(microbench_corpus_t* corpus, uint64_t* sink)
+{
+    for (int i=0; i<corpus->num_positions; ++i) {
+        position_t* pos = &corpus->positions[i];
+        for (int j=corpus->pseudo_offset[i];
+                j<corpus->pseudo_offset[i+1]; ++j) {
+            *sink += is_pseudo_move_legal(pos, corpus->pseudo_moves[j]);
+        }
+    }
+    return corpus->pseudo_offset[corpus->num_positions];
+}
+
+static uint64_t bench_full_eval(microbench_corpus_t* corpus, uint64_t* sink)
+{
+    eval_data_t ed;
+    for (int i=0; i<corpus->num_positions; ++i) {
+        *sink += full_eval(&corpus->positions[i], &ed);
+    }
+    return corpus->num_positions;
+}
+
+static uint64_t bench_simple_eval(microbench_corpus_t* corpus, uint64_t* sink)
+{
+    for (int i=0; i<corpus->num_positions; ++i) {
+        *sink += simple_eval(&corpus->positions[i]);
+    }
+    return corpus->num_positions;
+}
+
+static uint64_t bench_see(microbench_corpus_t* corpus, uint64_t* sink)
+{
+    for (int i=0; i<corpus->num_positions; ++i) {
+        const position_t* pos = &corpus->positions[i];
+        for (int j=corpus->capture_offset[i];
+                j<corpus->capture_offset[i+1]; ++j) {
+            *sink += static_exchange_eval(pos, corpus->captures[j]);
+        }
+    }
+    return corpus->capture_offset[corpus->num_positions];
+}
+
+static uint64_t bench_hash(microbench_corpus_t* corpus, uint64_t* sink)
+{
+    for (int i=0; i<corpus->num_positions; ++i) {
+        *sink += hash_position(&corpus->positions[i]);
+    }
+    return corpus->num_positions;
+}
+
+static uint64_t bench_tt_store(microbench_corpus_t* corpus, uint64_t* sink)
+{
+    for (int i=0; i<corpus->num_positions; ++i) {
+        position_t* pos = &corpus->positions[i];
+        move_t move = corpus->legal_offset[i] < corpus->legal_offset[i+1] ?
+            corpus->legal_moves[corpus->legal_offset[i]] : NO_MOVE;
+        put_transposition(pos, move, i & 15, i & 255,
+                SCORE_LOWERBOUND, false);
+    }
+    *sink += corpus->num_positions;
+    return corpus->num_positions;
+}
+
+static uint64_t bench_tt_probe(microbench_corpus_t* corpus, uint64_t* sink)
+{
+    transposition_entry_t entry;
+    for (int i=0; i<corpus->num_positions; ++i) {
+        *sink += get_transposition(&corpus->positions[i], &entry) != NULL;
+    }
+    return corpus->num_positions;
+}
+
+// The eval and exchange caches are cleared before each pass, so that we time
+// the work itself rather than a lookup. The pawn and material tables stay
+// warm, as they mostly are during a search. The transposition table probe
+// runs after the stores, so it mostly finds what it's looking for.
+static const microbench_t microbenches[] = {
+    { "do_move+undo_move", bench_do_undo, NULL },
+    { "generate_pseudo_moves", bench_pseudo_moves, NULL },
+    { "generate_evasions", bench_evasions, NULL },
+    { "is_pseudo_move_legal", bench_pseudo_legal, NULL },
+    { "full_eval", bench_full_eval, clear_eval_cache },
+    { "simple_eval", bench_simple_eval, NULL },
+    { "static_exchange_eval", bench_see, clear_see_cache },
+    { "hash_position", bench_hash, NULL },
+    { "put_transposition", bench_tt_store, NULL },
+    { "get_transposition", bench_tt_probe, NULL },
+    { NULL, NULL, NULL }
+};
+
+/*
+ * Time |bench| over |corpus| for at least |time_limit| milliseconds, and
+ * print the per call results.
+ */
+static void run_microbench(const microbench_t* bench,
+        microbench_corpus_t* corpus,
+        int time_limit,
+        uint64_t* sink)
+{
+    if (bench->reset) bench->reset();
+    uint64_t calls = bench->run(corpus, sink);
+    if (!calls) {
+        printf("%-22s %12s\n", bench->name, "no calls");
+        return;
+    }
+
+    uint64_t total_calls = 0, total_ns = 0, total_cycles = 0;
+    double best_ns = 0;
+    while (total_ns < (uint64_t)time_limit * 1000000) {
+        if (bench->reset) bench->reset();
+        uint64_t start_ns = nanosecond_clock();
+        uint64_t start_cycles = read_cycle_counter();
+        calls = bench->run(corpus, sink);
+        uint64_t cycles = read_cycle_counter() - start_cycles;
+        uint64_t ns = nanosecond_clock() - start_ns;
+        double ns_per_call = (double)ns / calls;
+        if (!total_calls || ns_per_call < best_ns) best_ns = ns_per_call;
+        total_calls += calls;
+        total_ns += ns;
+        total_cycles += cycles;
+    }
+    printf("%-22s %12"PRIu64" %10.2f %10.2f", bench->name, total_calls,
+            (double)total_ns / total_calls, best_ns);
+#ifdef NO_CYCLE_COUNTER
+    printf(" %11s\n", "n/a");
+#else
+    printf(" %11.1f\n", (double)total_cycles / total_calls);
+#endif
+}
+
+/*
+ * Time the engine's hot primitives one at a time. The arguments are
+ *   [positions <n>] [time <ms>] [<name>...]
+ * where <n> is the corpus size, <ms> is the minimum time spent on each
+ * primitive, and any names limit the run to primitives whose names contain
+ * one of them.
+ */
+void microbench(char* args)
+{
+    int num_positions = MICROBENCH_POSITIONS;
+    int time_limit = MICROBENCH_TIME;
+    char* filters[16];
+    int num_filters = 0;
+    char* token;
+    while ((token = strsep(&args, " \t\n"))) {
+        if (!*token) continue;
+        if (!strcasecmp(token, "positions") || !strcasecmp(token, "time")) {
+            char* value = NULL;
+            while (args && (value = strsep(&args, " \t\n")) && !*value) {}
+            if (!value) break;
+            if (*token == 'p') num_positions = MAX(atoi(value), 1);
+            else time_limit = MAX(atoi(value), 1);
+        } else if (num_filters < 16) {
+            filters[num_filters++] = token;
+        }
+    }
+
+    sync_transposition_table();
+    microbench_corpus_t* corpus =
+        (microbench_corpus_t*)malloc(sizeof(microbench_corpus_t));
+    init_corpus(corpus, num_positions);
+    printf("microbench: %d positions (%d in check), %d legal moves, "
+            "%d captures, %d ms per primitive\n",
+            corpus->num_positions, corpus->num_checks,
+            corpus->legal_offset[corpus->num_positions],
+            corpus->capture_offset[corpus->num_positions], time_limit);
+    printf("%-22s %12s %10s %10s %11s\n",
+            "primitive", "calls", "ns/call", "best ns", "cycles/call");
+
+    uint64_t sink = 0;
+    for (const microbench_t* bench=microbenches; bench->name; ++bench) {
+        bool wanted = !num_filters;
+        for (int i=0; i<num_filters && !wanted; ++i) {
+            wanted = strcasestr((char*)bench->name, filters[i]) != NULL;
+        }
+        if (wanted) run_microbench(bench, corpus, time_limit, &sink);
+    }
+    printf("checksum %016"PRIx64"\n", sink);
+
+    // Don't leave our made-up entries lying around for the next search.
+    clear_transposition_table();
+    free_corpus(corpus);
+    free(corpus);
+}
@@ -1,6 +1,31 @@
 
 #include "daydreamer.h"
 
+/*
+ * Record |hash| as the hash of the position at the current ply, and move on
+ * to the next ply.
+ */
+static void push_hash_history(position_t* pos, hashkey_t hash)
+{
+    hash_history_t* history = pos->hash_history;
+    assert(history);
+    history->hashes[pos->ply++] = hash;
+    assert(pos->ply <= HASH_HISTORY_LENGTH);
+    history->filter[repetition_filter_index(hash)]++;
+    assert(history->filter[repetition_filter_index(hash)]);
+}
+
+/*
+ * Step back one ply, forgetting the hash recorded there.
+ */
+static void pop_hash_history(position_t* pos)
+{
+    hash_history_t* history = pos->hash_history;
+    const hashkey_t hash = history->hashes[--pos->ply];
+    assert(history->filter[repetition_filter_index(hash)]);
+    history->filter[repetition_filter_index(hash)]--;
+}
+
 /*
  * Modify |pos| by adding |piece| to |square|. If |square| is occupied, its
  * occupant is properly removed.
@@ -18,6 +43,8 @@ void place_piece(position_t* pos, piece_t piece, square_t square)
     assert(square != INVALID_SQUARE);
 
     pos->board[square] = piece;
+    set_sq_bit(pos->occupied_bb[color], square);
+    set_sq_bit(pos->piece_bb[piece], square);
     if (piece_is_type(piece, PAWN)) {
         int index = pos->num_pawns[color]++;
         pos->pawns[color][index] = square;
@@ -71,6 +98,8 @@ void remove_piece(position_t* pos, square_t square)
         }
     }
     pos->board[square] = EMPTY;
+    clear_sq_bit(pos->occupied_bb[color], square);
+    clear_sq_bit(pos->piece_bb[piece], square);
     pos->piece_index[square] = -1;
     pos->piece_count[piece]--;
     pos->hash ^= piece_hash(piece, square);
@@ -98,6 +127,9 @@ void transfer_piece(position_t* pos, square_t from, square_t to)
     int index = pos->piece_index[to] = pos->piece_index[from];
     color_t color = piece_color(p);
     pos->board[from] = EMPTY;
+    const bitboard_t from_to = sq_bit(from) | sq_bit(to);
+    pos->occupied_bb[color] ^= from_to;
+    pos->piece_bb[p] ^= from_to;
     if (piece_is_type(p, PAWN)) {
         pos->pawns[color][index] = to;
         pos->piece_index[to] = index;
@@ -123,6 +155,7 @@ void transfer_piece(position_t* pos, square_t from, square_t to)
  */
 void do_move(position_t* pos, move_t move, undo_info_t* undo)
 {
+    instrument_count(COUNTER_MOVES_MADE);
     check_move_validity(pos, move);
     check_board_validity(pos);
     // Set undo info, so we can roll back later.
@@ -197,14 +230,21 @@ void do_move(position_t* pos, move_t move, undo_info_t* undo)
         place_piece(pos, create_piece(side, promote_type), to);
     }
 
-    pos->hash_history[pos->ply++] = undo->hash;
-    assert(pos->ply <= HASH_HISTORY_LENGTH);
+    push_hash_history(pos, undo->hash);
     pos->side_to_move = flip_color(pos->side_to_move);
-    pos->is_check = find_checks(pos);
-    pos->prev_move = move;
     pos->hash ^= ep_hash(pos);
     pos->hash ^= castle_hash(pos);
     pos->hash ^= side_hash(pos);
+
+    // The hash keys are final, so get the table lookups that follow this
+    // move started while we look for checks.
+    prefetch_transposition(pos->hash);
+    prefetch_pawn_data(pos->pawn_hash);
+    prefetch_material_data(pos->material_hash);
+    prefetch_eval_cache(pos->hash);
+
+    pos->is_check = find_checks(pos);
+    pos->prev_move = move;
     check_board_validity(pos);
 }
 
@@ -246,7 +286,7 @@ void undo_move(position_t* pos, move_t move, undo_info_t* undo)
 
     // Reset non-board state information.
     pos->side_to_move = flip_color(pos->side_to_move);
-    pos->ply--;
+    pop_hash_history(pos);
     pos->is_check = undo->is_check;
     pos->check_square = undo->check_square;
     pos->ep_square = undo->ep_square;
@@ -278,8 +318,9 @@ void do_nullmove(position_t* pos, undo_info_t* undo)
     pos->hash ^= side_hash(pos);
     pos->ep_square = EMPTY;
     pos->hash ^= ep_hash(pos);
+    prefetch_transposition(pos->hash);
     pos->fifty_move_counter++;
-    pos->hash_history[pos->ply++] = undo->hash;
+    push_hash_history(pos, undo->hash);
     pos->prev_move = NULL_MOVE;
     check_board_validity(pos);
 }
@@ -299,7 +340,7 @@ void undo_nullmove(position_t* pos, undo_info_t* undo)
     pos->hash = undo->hash;
     pos->is_check = undo->is_check;
     pos->check_square = undo->check_square;
-    pos->ply--;
+    pop_hash_history(pos);
     check_board_validity(pos);
 }
 
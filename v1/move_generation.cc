@@ -1,10 +1,8 @@
 
 #include "daydreamer.h"
 
-static void generate_pawn_captures(const position_t* pos,
-        square_t from,
-        piece_t piece,
-        move_t** moves);
+template <color_t side>
+static void generate_pawn_captures(const position_t* pos, move_t** moves);
 static void generate_piece_captures(const position_t* pos,
         square_t from,
         piece_t piece,
@@ -13,10 +11,10 @@ static void generate_piece_noncaptures(const position_t* pos,
         square_t from,
         piece_t piece,
         move_t** moves);
+template <color_t side>
 static int generate_promotions(const position_t* pos, move_t* moves);
+template <color_t side>
 static void generate_pawn_quiet_moves(const position_t* pos,
-        square_t from,
-        piece_t piece,
         move_t** moves_head);
 static int generate_pseudo_captures(const position_t* pos, move_t* moves);
 
@@ -34,9 +32,12 @@ static move_t* add_move(const position_t* pos,
 }
 
 /*
- * Fill the provided list with all legal moves in the given position.
+ * Fill the provided list with all legal moves in the given position, by
+ * generating pseudo-legal moves and then checking each one. The bitboard
+ * generator in legal_move_generation.cc is normally used instead; this
+ * version is kept as a reference to check it against.
  */
-int generate_legal_moves(position_t* pos, move_t* moves)
+int generate_reference_legal_moves(position_t* pos, move_t* moves)
 {
     if (is_check(pos)) return generate_evasions(pos, moves);
     int num_pseudo = generate_pseudo_moves(pos, moves);
@@ -61,7 +62,11 @@ int generate_legal_moves(position_t* pos, move_t* moves)
 int generate_pseudo_tactical_moves(const position_t* pos, move_t* moves)
 {
     move_t* moves_head = moves;
-    moves += generate_promotions(pos, moves);
+    if (pos->side_to_move == WHITE) {
+        moves += generate_promotions<WHITE>(pos, moves);
+    } else {
+        moves += generate_promotions<BLACK>(pos, moves);
+    }
     moves += generate_pseudo_captures(pos, moves);
     return moves - moves_head;
 }
@@ -89,6 +94,7 @@ int generate_quiescence_moves(const position_t* pos,
         bool generate_checks)
 {
     if (is_check(pos)) return generate_evasions(pos, moves);
+    instrument_scope(TIMER_GEN_QSEARCH);
     move_t* moves_head = moves;
     moves += generate_pseudo_tactical_moves(pos, moves);
     if (generate_checks) moves += generate_pseudo_checks(pos, moves);
@@ -109,11 +115,8 @@ static int generate_pseudo_captures(const position_t* pos, move_t* moves)
         piece = pos->board[from];
         generate_piece_captures(pos, from, piece, &moves);
     }
-    piece = create_piece(side, PAWN);
-    for (int i=0; i<pos->num_pawns[side]; ++i) {
-        from = pos->pawns[side][i];
-        generate_pawn_captures(pos, from, piece, &moves);
-    }
+    if (side == WHITE) generate_pawn_captures<WHITE>(pos, &moves);
+    else generate_pawn_captures<BLACK>(pos, &moves);
     *moves = 0;
     return moves-moves_head;
 }
@@ -128,6 +131,28 @@ int generate_pseudo_quiet_moves(const position_t* pos, move_t* moves)
     piece_t piece;
     square_t from;
 
+    moves += generate_pseudo_castles(pos, moves);
+    for (int i = 0; i < pos->num_pieces[side]; ++i) {
+        from = pos->pieces[side][i];
+        piece = pos->board[from];
+        assert(piece_color(piece) == side && piece_type(piece) != PAWN);
+        generate_piece_noncaptures(pos, from, piece, &moves);
+    }
+    if (side == WHITE) generate_pawn_quiet_moves<WHITE>(pos, &moves);
+    else generate_pawn_quiet_moves<BLACK>(pos, &moves);
+
+    *moves = 0;
+    return (moves-moves_head);
+}
+
+/*
+ * Generate pseudo-legal castling moves.
+ */
+int generate_pseudo_castles(const position_t* pos, move_t* moves)
+{
+    move_t* moves_head = moves;
+    color_t side = pos->side_to_move;
+
     // Castling. Castles are considered pseudo-legal if we have appropriate
     // castling rights, the squares between king and rook are unoccupied,
     // and the intermediate square is unattacked. Therefore checking for
@@ -229,20 +254,6 @@ int generate_pseudo_quiet_moves(const position_t* pos, move_t* moves)
                     moves);
         }
     }
-
-    for (int i = 0; i < pos->num_pieces[side]; ++i) {
-        from = pos->pieces[side][i];
-        piece = pos->board[from];
-        assert(piece_color(piece) == side && piece_type(piece) != PAWN);
-        generate_piece_noncaptures(pos, from, piece, &moves);
-    }
-    piece = create_piece(side, PAWN);
-    for (int i=0; i<pos->num_pawns[side]; ++i) {
-        from = pos->pawns[side][i];
-        assert(pos->board[from] == piece);
-        generate_pawn_quiet_moves(pos, from, piece, &moves);
-    }
-
     *moves = 0;
     return (moves-moves_head);
 }
@@ -250,16 +261,16 @@ int generate_pseudo_quiet_moves(const position_t* pos, move_t* moves)
 /*
  * Add all pseudo-legal non-capturing promotions.
  */
+template <color_t side>
 static int generate_promotions(const position_t* pos, move_t* moves)
 {
     move_t* moves_head = moves;
-    color_t side = pos->side_to_move;
-    piece_t piece = create_piece(side, PAWN);
+    const piece_t piece = create_piece(side, PAWN);
     for (int i = 0; i < pos->num_pawns[side]; ++i) {
         square_t from = pos->pawns[side][i];
-        rank_t r_rank = relative_rank[side][square_rank(from)];
+        rank_t r_rank = color_relative_rank(side, square_rank(from));
         if (r_rank < RANK_7) continue;
-        square_t to = from + pawn_push[side];
+        square_t to = from + color_pawn_push(side);
         if (pos->board[to]) continue;
         for (piece_type_t type=KNIGHT; type<=QUEEN; ++type) {
             moves = add_move(pos,
@@ -277,6 +288,7 @@ static int generate_promotions(const position_t* pos, move_t* moves)
  */
 int generate_evasions(const position_t* pos, move_t* moves)
 {
+    instrument_scope(TIMER_GEN_EVASIONS);
     assert(pos->is_check && pos->board[pos->check_square]);
     move_t* moves_head = moves;
     color_t side = pos->side_to_move;
@@ -287,20 +299,20 @@ int generate_evasions(const position_t* pos, move_t* moves)
     piece_t checker = pos->board[check_sq];
 
     // Generate king moves.
-    // Don't let the king mask its possible destination squares in calls
-    // to is_square_attacked.
+    // Don't let the king mask its possible destination squares when looking
+    // for attackers.
     square_t from = king_sq, to = INVALID_SQUARE;
-    ((position_t*)pos)->board[king_sq] = EMPTY;
+    const bitboard_t occupied = (pos->occupied_bb[WHITE] |
+            pos->occupied_bb[BLACK]) & ~sq_bit(king_sq);
     for (const direction_t* delta = piece_deltas[king]; *delta; ++delta) {
         to = from + *delta;
         piece_t capture = pos->board[to];
+        if (capture == OUT_OF_BOUNDS) continue;
         if (capture != EMPTY && !can_capture(king, capture)) continue;
-        if (is_square_attacked((position_t*)pos,to,other_side)) continue;
-        ((position_t*)pos)->board[king_sq] = king;
+        if (attackers_to(pos, to, occupied) &
+                pos->occupied_bb[other_side]) continue;
         moves = add_move(pos, create_move(from, to, king, capture), moves);
-        ((position_t*)pos)->board[king_sq] = EMPTY;
     }
-    ((position_t*)pos)->board[king_sq] = king;
     // If there are multiple checkers, only king moves are possible.
     if (pos->is_check > 1) {
         *moves = 0;
@@ -593,51 +605,55 @@ int generate_pseudo_checks(const position_t* pos, move_t* moves)
 }
 
 /*
- * Add all pseudo-legal captures that the given pawn can make.
+ * Add all pseudo-legal captures that pawns of color |side| can make. The
+ * color is a template parameter so that the capture directions and rank
+ * tests are compiled in as constants.
  */
-static void generate_pawn_captures(const position_t* pos,
-        square_t from,
-        piece_t piece,
-        move_t** moves_head)
+template <color_t side>
+static void generate_pawn_captures(const position_t* pos, move_t** moves_head)
 {
-    color_t side = pos->side_to_move;
-    int cap_left = side == WHITE ? 15 : -15;
-    int cap_right = side == WHITE ? 17 : -17;
-    square_t to;
-    rank_t r_rank = relative_rank[side][square_rank(from)];
+    const int cap_left = side == WHITE ? NW : SE;
+    const int cap_right = side == WHITE ? NE : SW;
+    const piece_t piece = create_piece(side, PAWN);
+    const direction_t back = color_pawn_push(flip_color(side));
     move_t* moves = *moves_head;
-    if (r_rank < RANK_7) {
-        // non-promote captures
-        to = from + cap_left;
-        if (pos->board[to] != EMPTY && can_capture(piece, pos->board[to])) {
-            moves = add_move(pos, create_move(from, to, piece,
-                    pos->board[to]), moves);
-        } else if (to == pos->ep_square && pos->board[to] == EMPTY) {
-            moves = add_move(pos, create_move_enpassant(from, to, piece,
-                    pos->board[to + pawn_push[side^1]]), moves);
-        }
-        to = from + cap_right;
-        if (pos->board[to] != EMPTY && can_capture(piece, pos->board[to])) {
-            moves = add_move(pos, create_move(from, to, piece,
-                    pos->board[to]), moves);
-        } else if (to == pos->ep_square && pos->board[to] == EMPTY) {
-            moves = add_move(pos, create_move_enpassant(from, to, piece,
-                    pos->board[to + pawn_push[side^1]]), moves);
-        }
-    } else {
-        // capture/promotes
-        to = from + cap_left;
-        if (pos->board[to] != EMPTY && can_capture(piece, pos->board[to])) {
-            for (piece_type_t promoted=QUEEN; promoted > PAWN; --promoted) {
-                moves = add_move(pos, create_move_promote(from, to, piece,
-                        pos->board[to], promoted), moves);
+    for (int i=0; i<pos->num_pawns[side]; ++i) {
+        const square_t from = pos->pawns[side][i];
+        square_t to;
+        rank_t r_rank = color_relative_rank(side, square_rank(from));
+        if (r_rank < RANK_7) {
+            // non-promote captures
+            to = from + cap_left;
+            if (pos->board[to] != EMPTY && can_capture(piece, pos->board[to])) {
+                moves = add_move(pos, create_move(from, to, piece,
+                        pos->board[to]), moves);
+            } else if (to == pos->ep_square && pos->board[to] == EMPTY) {
+                moves = add_move(pos, create_move_enpassant(from, to, piece,
+                        pos->board[to + back]), moves);
             }
-        }
-        to = from + cap_right;
-        if (pos->board[to] != EMPTY && can_capture(piece, pos->board[to])) {
-            for (piece_type_t promoted=QUEEN; promoted > PAWN; --promoted) {
-                moves = add_move(pos, create_move_promote(from, to, piece,
-                        pos->board[to], promoted), moves);
+            to = from + cap_right;
+            if (pos->board[to] != EMPTY && can_capture(piece, pos->board[to])) {
+                moves = add_move(pos, create_move(from, to, piece,
+                        pos->board[to]), moves);
+            } else if (to == pos->ep_square && pos->board[to] == EMPTY) {
+                moves = add_move(pos, create_move_enpassant(from, to, piece,
+                        pos->board[to + back]), moves);
+            }
+        } else {
+            // capture/promotes
+            to = from + cap_left;
+            if (pos->board[to] != EMPTY && can_capture(piece, pos->board[to])) {
+                for (piece_type_t promoted=QUEEN; promoted > PAWN; --promoted) {
+                    moves = add_move(pos, create_move_promote(from, to, piece,
+                            pos->board[to], promoted), moves);
+                }
+            }
+            to = from + cap_right;
+            if (pos->board[to] != EMPTY && can_capture(piece, pos->board[to])) {
+                for (piece_type_t promoted=QUEEN; promoted > PAWN; --promoted) {
+                    moves = add_move(pos, create_move_promote(from, to, piece,
+                            pos->board[to], promoted), moves);
+                }
             }
         }
     }
@@ -645,26 +661,29 @@ static void generate_pawn_captures(const position_t* pos,
 }
 
 /*
- * Generate all non-capturing, non-promoting pawn moves.
+ * Generate all non-capturing, non-promoting moves for pawns of color |side|.
  */
+template <color_t side>
 static void generate_pawn_quiet_moves(const position_t* pos,
-        square_t from,
-        piece_t piece,
         move_t** moves_head)
 {
-    color_t side = pos->side_to_move;
-    square_t to;
-    rank_t r_rank = relative_rank[side][square_rank(from)];
+    const direction_t push = color_pawn_push(side);
+    const piece_t piece = create_piece(side, PAWN);
     move_t* moves = *moves_head;
-    to = from + pawn_push[side];
-    if (r_rank == RANK_7 || pos->board[to] != EMPTY) return;
-    moves = add_move(pos, create_move(from, to, piece, EMPTY), moves);
-    to += pawn_push[side];
-    if (r_rank == RANK_2 && pos->board[to] == EMPTY) {
-        // initial two-square push
-        moves = add_move(pos,
-                create_move(from, to, piece, EMPTY),
-                moves);
+    for (int i=0; i<pos->num_pawns[side]; ++i) {
+        const square_t from = pos->pawns[side][i];
+        assert(pos->board[from] == piece);
+        rank_t r_rank = color_relative_rank(side, square_rank(from));
+        square_t to = from + push;
+        if (r_rank == RANK_7 || pos->board[to] != EMPTY) continue;
+        moves = add_move(pos, create_move(from, to, piece, EMPTY), moves);
+        to += push;
+        if (r_rank == RANK_2 && pos->board[to] == EMPTY) {
+            // initial two-square push
+            moves = add_move(pos,
+                    create_move(from, to, piece, EMPTY),
+                    moves);
+        }
     }
     *moves_head = moves;
 }
@@ -2,41 +2,61 @@
 #include "daydreamer.h"
 #include <string.h>
 
-extern search_data_t root_data;
 static const bool defer_enabled = false;
 static bool pv_cache_enabled = true;
 
-selection_phase_t phase_table[6][8] = {
+// Generated move lists aren't sorted up front. Instead, the best remaining
+// move is picked out each time one is needed, and once this many moves have
+// been picked from a list, the rest of the list is sorted in one go. Indexed
+// by generation_t; 0 means always sort, INT_MAX means never sort. Pv nodes
+// search every move, so they just sort.
+static const int pick_limit[NUM_GENERATORS] = { 0, 0, 3, 3, 3, 3 };
+
+/*
+ * Outside of the root, evasions, and quiescence, moves are generated in
+ * stages, so that a node that cuts off early never pays for generating and
+ * scoring quiet moves. At pv nodes, a pv cache hit replaces all the
+ * generated stages.
+ */
+selection_phase_t phase_table[6][10] = {
     { PHASE_BEGIN, PHASE_ROOT, PHASE_END },
-    { PHASE_BEGIN, PHASE_TRANS, PHASE_PV, PHASE_DEFERRED, PHASE_END },
-    { PHASE_BEGIN, PHASE_TRANS, PHASE_NON_PV, PHASE_DEFERRED, PHASE_END },
+    { PHASE_BEGIN, PHASE_TRANS, PHASE_PV, PHASE_GOOD_TACTICS, PHASE_KILLERS,
+        PHASE_QUIET, PHASE_BAD_TACTICS, PHASE_DEFERRED, PHASE_END },
+    { PHASE_BEGIN, PHASE_TRANS, PHASE_GOOD_TACTICS, PHASE_KILLERS,
+        PHASE_QUIET, PHASE_BAD_TACTICS, PHASE_DEFERRED, PHASE_END },
     { PHASE_BEGIN, PHASE_EVASIONS, PHASE_DEFERRED, PHASE_END },
     { PHASE_BEGIN, PHASE_TRANS, PHASE_QSEARCH, PHASE_DEFERRED, PHASE_END },
     { PHASE_BEGIN, PHASE_TRANS, PHASE_QSEARCH_CH, PHASE_DEFERRED, PHASE_END },
 };
 
-typedef struct {
-    hashkey_t key;
-    move_t moves[256];
-    int64_t nodes[256];
-} move_cache_t;
-
 static void generate_moves(move_selector_t* sel);
+static move_t select_next_move(move_selector_t* sel);
+static void score_tactics(move_selector_t* sel);
+static void score_quiet_moves(move_selector_t* sel);
 static void score_moves(move_selector_t* sel);
 static void score_qsearch_moves(move_selector_t* sel);
 static void sort_moves(move_selector_t* sel);
 static void sort_qsearch_moves(move_selector_t* sel);
 static void sort_root_moves(move_selector_t* sel);
 static void sort_move_list(move_selector_t* sel);
-static int64_t score_tactical_move(position_t* pos, move_t move);
-static move_t get_best_move(move_selector_t* sel, int64_t* score);
+static void pick_move(move_selector_t* sel);
+static void validate_killers(move_selector_t* sel);
+static bool is_killer(move_selector_t* sel, move_t move);
+static int score_tactical_move(position_t* pos, move_t move);
+static int history_score(const move_selector_t* sel, move_t move);
+static int node_count_shift(uint64_t max_nodes);
 static move_cache_t* get_pv_move_list(const position_t* pos);
 
+// Nodes searched under each move at the pv nodes currently being searched,
+// indexed by ply. Only the main thread keeps pv node counts.
+static move_cache_t pv_move_lists[MAX_SEARCH_PLY+1];
+
 /*
  * Initialize the move selector data structure with the information needed to
  * determine what kind of moves to generate and how to order them.
  */
 void init_move_selector(move_selector_t* sel,
+        search_data_t* data,
         position_t* pos,
         generation_t gen_type,
         search_node_t* search_node,
@@ -45,6 +65,7 @@ void init_move_selector(move_selector_t* sel,
         int ply)
 {
     sel->pos = pos;
+    sel->data = data;
     if (is_check(pos) && gen_type != ROOT_GEN) {
         sel->generator = ESCAPE_GEN;
     } else {
@@ -57,6 +78,15 @@ void init_move_selector(move_selector_t* sel,
     sel->moves_so_far = 0;
     sel->quiet_moves_so_far = 0;
     sel->pv_index = 0;
+    sel->pv_list = NULL;
+    if (gen_type == PV_GEN && sel->generator != ESCAPE_GEN &&
+            !data->thread_id) {
+        assert(ply >= 0 && ply <= MAX_SEARCH_PLY);
+        sel->pv_list = &pv_move_lists[ply];
+    }
+    sel->tactics_end = 0;
+    sel->bad_tactics_index = 0;
+    sel->num_killers = 0;
     if (search_node) {
         sel->mate_killer = search_node->mate_killer;
         sel->killers[0] = search_node->killers[0];
@@ -69,10 +99,15 @@ void init_move_selector(move_selector_t* sel,
         }
         sel->killers[4] = NO_MOVE;
     } else {
-        sel->killers[0] = sel->killers[1] = NO_MOVE;
+        sel->mate_killer = NO_MOVE;
+        for (int i=0; i<5; ++i) sel->killers[i] = NO_MOVE;
     }
     sel->deferred_moves[0] = NO_MOVE;
     sel->num_deferred_moves = 0;
+    if (sel->generator == PV_GEN || sel->generator == NONPV_GEN) {
+        data->stats.staged_nodes++;
+    }
+    data->stats.selector_nodes[sel->generator]++;
     generate_moves(sel);
 }
 
@@ -125,6 +160,7 @@ static void generate_moves(move_selector_t* sel)
     sel->current_move_index = 0;
     sel->moves = sel->base_moves;
     sel->scores = sel->base_scores;
+    sel->sorted = true;
     move_cache_t* pv_cache;
     switch (*sel->phase) {
         case PHASE_BEGIN:
@@ -143,12 +179,21 @@ static void generate_moves(move_selector_t* sel)
             sort_root_moves(sel);
             break;
         case PHASE_PV:
-            pv_cache = get_pv_move_list(sel->pos);
-            if (pv_cache_enabled && pv_cache->key == sel->pos->hash) {
+            // The pv cache isn't shared between threads, only the main
+            // thread gets to use it.
+            pv_cache = sel->data->thread_id ?
+                NULL : get_pv_move_list(sel->pos);
+            if (pv_cache_enabled && pv_cache &&
+                    pv_cache->key == sel->pos->hash) {
                 int i;
+                uint64_t max_nodes = 0;
+                for (i=0; pv_cache->moves[i]; ++i) {
+                    max_nodes = MAX(max_nodes, (uint64_t)pv_cache->nodes[i]);
+                }
+                const int shift = node_count_shift(max_nodes);
                 for (i=0; pv_cache->moves[i]; ++i) {
                     sel->moves[i] = pv_cache->moves[i];
-                    sel->scores[i] = pv_cache->nodes[i];
+                    sel->scores[i] = (int)(pv_cache->nodes[i] >> shift);
                     assert2(is_move_legal(sel->pos, sel->moves[i]));
                 }
                 sel->moves[i] = NO_MOVE;
@@ -156,10 +201,56 @@ static void generate_moves(move_selector_t* sel)
                 sort_move_list(sel);
                 break;
             }
+            generate_moves(sel);
+            return;
         case PHASE_NON_PV:
             sel->moves_end = generate_pseudo_moves(sel->pos, sel->moves);
             sort_moves(sel);
             break;
+        case PHASE_GOOD_TACTICS:
+            // Captures and promotions share the front of the move list with
+            // the mate killer. Moves are selected from here until we hit the
+            // first losing tactic, and the rest are saved for later.
+            sel->moves_end = generate_legal_tactical_moves(
+                    sel->pos, sel->moves);
+            if (!sel->mate_killer || sel->mate_killer == sel->hash_move[0] ||
+                    !is_plausible_move_legal(sel->pos, sel->mate_killer)) {
+                sel->mate_killer = NO_MOVE;
+            } else if (!get_move_capture(sel->mate_killer) &&
+                    !get_move_promote(sel->mate_killer)) {
+                sel->moves[sel->moves_end++] = sel->mate_killer;
+                sel->moves[sel->moves_end] = NO_MOVE;
+            }
+            sel->data->stats.moves_generated += sel->moves_end;
+            score_tactics(sel);
+            sel->sorted = false;
+            sel->tactics_end = sel->moves_end;
+            sel->bad_tactics_index = sel->moves_end;
+            break;
+        case PHASE_KILLERS:
+            validate_killers(sel);
+            sel->moves = sel->killers;
+            sel->scores += sel->tactics_end + 1;
+            sel->moves_end = sel->num_killers;
+            for (int i=0; i<sel->num_killers; ++i) {
+                sel->scores[i] = 700*MAX_HISTORY - i;
+            }
+            break;
+        case PHASE_QUIET:
+            sel->moves += sel->tactics_end + 1;
+            sel->scores += sel->tactics_end + 1;
+            sel->moves_end = generate_legal_quiet_moves(sel->pos, sel->moves);
+            sel->data->stats.quiet_generations++;
+            sel->data->stats.moves_generated += sel->moves_end;
+            score_quiet_moves(sel);
+            sel->sorted = false;
+            break;
+        case PHASE_BAD_TACTICS:
+            sel->moves += sel->bad_tactics_index;
+            sel->scores += sel->bad_tactics_index;
+            sel->moves_end = sel->tactics_end - sel->bad_tactics_index;
+            sel->sorted = false;
+            break;
         case PHASE_QSEARCH_CH:
             sel->moves_end = generate_quiescence_moves(
                     sel->pos, sel->moves, true);
@@ -177,14 +268,32 @@ static void generate_moves(move_selector_t* sel)
         default: assert(false);
     }
     sel->single_reply = sel->generator == ESCAPE_GEN && sel->moves_end == 1;
+    instrument_histogram(HISTOGRAM_MOVE_LIST_LENGTH, sel->moves_end);
     assert(sel->moves[sel->moves_end] == NO_MOVE);
     assert(sel->current_move_index == 0);
 }
 
 /*
- * Return the next move to be searched.
+ * Return the next move to be searched, keeping track of how many moves are
+ * taken at each kind of node.
  */
 move_t select_move(move_selector_t* sel)
+{
+    move_t move = select_next_move(sel);
+    if (!move) return move;
+    search_stats_t* stats = &sel->data->stats;
+    stats->moves_selected[sel->generator]++;
+    if (sel->moves_so_far <= HIST_BUCKETS + 1) {
+        stats->moves_consumed[sel->generator][sel->moves_so_far-1]++;
+    }
+    return move;
+}
+
+/*
+ * Find the next move to be searched, moving on to the next phase when the
+ * current one runs out.
+ */
+static move_t select_next_move(move_selector_t* sel)
 {
     if (*sel->phase == PHASE_END) return NO_MOVE;
 
@@ -197,6 +306,7 @@ move_t select_move(move_selector_t* sel)
             return move;
         case PHASE_ROOT:
         case PHASE_EVASIONS:
+            pick_move(sel);
             move = sel->moves[sel->current_move_index++];
             if (!move) break;
             sel->moves_so_far++;
@@ -208,6 +318,7 @@ move_t select_move(move_selector_t* sel)
         case PHASE_NON_PV:
             while (true) {
                 assert(sel->current_move_index <= sel->moves_end);
+                pick_move(sel);
                 move = sel->moves[sel->current_move_index++];
                 if (!move) break;
                 if (move == sel->hash_move[0] ||
@@ -219,12 +330,65 @@ move_t select_move(move_selector_t* sel)
                 }
                 return move;
             }
+            // If the pv cache supplied our moves, there's nothing left to
+            // generate.
+            if (*sel->phase == PHASE_PV) {
+                while (sel->phase[1] != PHASE_DEFERRED) sel->phase++;
+            }
+            break;
+        case PHASE_GOOD_TACTICS:
+            while (true) {
+                assert(sel->current_move_index <= sel->moves_end);
+                pick_move(sel);
+                move = sel->moves[sel->current_move_index];
+                if (!move || sel->scores[sel->current_move_index] < 0) {
+                    // Everything that's left is a losing tactic.
+                    sel->bad_tactics_index = sel->current_move_index;
+                    break;
+                }
+                sel->current_move_index++;
+                // Tactics come from the legal generator, and the mate killer
+                // has already been checked.
+                if (move == sel->hash_move[0]) continue;
+                assert2(is_move_legal(sel->pos, move));
+                sel->moves_so_far++;
+                if (!get_move_capture(move) && get_move_promote(move)!=QUEEN) {
+                    sel->quiet_moves_so_far++;
+                }
+                return move;
+            }
+            break;
+        case PHASE_KILLERS:
+            // Killers were checked for legality when they were validated.
+            move = sel->moves[sel->current_move_index++];
+            if (!move) break;
+            sel->moves_so_far++;
+            sel->quiet_moves_so_far++;
+            return move;
+        case PHASE_QUIET:
+        case PHASE_BAD_TACTICS:
+            while (true) {
+                assert(sel->current_move_index <= sel->moves_end);
+                pick_move(sel);
+                move = sel->moves[sel->current_move_index++];
+                if (!move) break;
+                if (move == sel->hash_move[0] ||
+                        move == sel->mate_killer ||
+                        is_killer(sel, move)) continue;
+                assert2(is_move_legal(sel->pos, move));
+                sel->moves_so_far++;
+                if (!get_move_capture(move) && get_move_promote(move)!=QUEEN) {
+                    sel->quiet_moves_so_far++;
+                }
+                return move;
+            }
             break;
 
         case PHASE_QSEARCH:
         case PHASE_QSEARCH_CH:
             while (true) {
                 assert(sel->current_move_index <= sel->moves_end);
+                pick_move(sel);
                 move = sel->moves[sel->current_move_index++];
                 if (!move) break;
                 const piece_type_t promote = get_move_promote(move);
@@ -254,7 +418,7 @@ move_t select_move(move_selector_t* sel)
 
     assert(*sel->phase != PHASE_END);
     generate_moves(sel);
-    return select_move(sel);
+    return select_next_move(sel);
 }
 
 /*
@@ -266,14 +430,14 @@ move_t select_move(move_selector_t* sel)
 static void score_moves(move_selector_t* sel)
 {
     move_t* moves = sel->moves;
-    int64_t* scores = sel->scores;
+    int* scores = sel->scores;
 
-    const int64_t grain = MAX_HISTORY;
-    const int64_t hash_score = 1000 * grain;
-    const int64_t killer_score = 700 * grain;
+    const int grain = MAX_HISTORY;
+    const int hash_score = 1000 * grain;
+    const int killer_score = 700 * grain;
     for (int i=0; moves[i] != NO_MOVE; ++i) {
         const move_t move = moves[i];
-        int64_t score = 0ull;
+        int score = 0;
         if (move == sel->hash_move[0]) {
             score = hash_score;
         } else if (move == sel->mate_killer) {
@@ -289,12 +453,82 @@ static void score_moves(move_selector_t* sel)
         } else if (move == sel->killers[3]) {
             score = killer_score-3;
         } else {
-            score = (int64_t)root_data.history.history[history_index(move)];
+            score = history_score(sel, move);
         }
         scores[i] = score;
     }
 }
 
+/*
+ * Score the captures and promotions generated for the first tactical phase.
+ * Losing tactics get negative scores, which marks where the good tactics end.
+ */
+static void score_tactics(move_selector_t* sel)
+{
+    move_t* moves = sel->moves;
+    int* scores = sel->scores;
+
+    const int grain = MAX_HISTORY;
+    const int hash_score = 1000 * grain;
+    for (int i=0; moves[i] != NO_MOVE; ++i) {
+        const move_t move = moves[i];
+        if (move == sel->hash_move[0]) {
+            scores[i] = hash_score;
+        } else if (move == sel->mate_killer) {
+            scores[i] = hash_score-1;
+        } else {
+            scores[i] = score_tactical_move(sel->pos, move);
+        }
+    }
+}
+
+/*
+ * Score quiet moves according to the history heuristic.
+ */
+static void score_quiet_moves(move_selector_t* sel)
+{
+    move_t* moves = sel->moves;
+    int* scores = sel->scores;
+    for (int i=0; moves[i] != NO_MOVE; ++i) {
+        scores[i] = history_score(sel, moves[i]);
+    }
+}
+
+/*
+ * Compact the killer list down to the quiet killers that are legal in the
+ * current position and haven't already been tried as the hash move or mate
+ * killer. This lets us search killers before quiet moves are generated.
+ */
+static void validate_killers(move_selector_t* sel)
+{
+    int num_killers = 0;
+    for (int i=0; i<4; ++i) {
+        move_t move = sel->killers[i];
+        if (!move || move == sel->hash_move[0] ||
+                move == sel->mate_killer ||
+                get_move_capture(move) || get_move_promote(move)) continue;
+        bool duplicate = false;
+        for (int j=0; j<num_killers; ++j) {
+            if (sel->killers[j] == move) duplicate = true;
+        }
+        if (duplicate || !is_plausible_move_legal(sel->pos, move)) continue;
+        sel->killers[num_killers++] = move;
+    }
+    for (int i=num_killers; i<5; ++i) sel->killers[i] = NO_MOVE;
+    sel->num_killers = num_killers;
+}
+
+/*
+ * Was |move| already searched during the killer phase?
+ */
+static bool is_killer(move_selector_t* sel, move_t move)
+{
+    for (int i=0; i<sel->num_killers; ++i) {
+        if (sel->killers[i] == move) return true;
+    }
+    return false;
+}
+
 /*
  * Quiescence-specific move scoring. This is simpler than normal scoring,
  * because SEE testing is deferred until after futility in the quiescent search.
@@ -303,13 +537,13 @@ static void score_moves(move_selector_t* sel)
 static void score_qsearch_moves(move_selector_t* sel)
 {
     move_t* moves = sel->moves;
-    int64_t* scores = sel->scores;
+    int* scores = sel->scores;
 
-    const int64_t grain = MAX_HISTORY;
-    const int64_t hash_score = 1000 * grain;
+    const int grain = MAX_HISTORY;
+    const int hash_score = 1000 * grain;
     for (int i=0; moves[i] != NO_MOVE; ++i) {
         const move_t move = moves[i];
-        int64_t score = 0ull;
+        int score = 0;
         if (move == sel->hash_move[0]) {
             score = hash_score;
         } else if (get_move_capture(move) || get_move_promote(move)) {
@@ -320,7 +554,7 @@ static void score_qsearch_moves(move_selector_t* sel)
             if (promote == QUEEN) tactic_bonus = 100;
             score = 6*capture - piece + 5 + tactic_bonus;
         } else {
-            score = root_data.history.history[history_index(move)];
+            score = history_score(sel, move);
         }
         scores[i] = score;
     }
@@ -329,11 +563,11 @@ static void score_qsearch_moves(move_selector_t* sel)
 /*
  * Determine a score for a capturing or promoting move.
  */
-static int64_t score_tactical_move(position_t* pos, move_t move)
+static int score_tactical_move(position_t* pos, move_t move)
 {
-    const int64_t grain = MAX_HISTORY;
-    const int64_t good_tactic_score = 800 * grain;
-    const int64_t bad_tactic_score = -800 * grain;
+    const int grain = MAX_HISTORY;
+    const int good_tactic_score = 800 * grain;
+    const int bad_tactic_score = -800 * grain;
     bool good_tactic;
     piece_type_t piece = get_move_piece_type(move);
     piece_type_t promote = get_move_promote(move);
@@ -345,6 +579,29 @@ static int64_t score_tactical_move(position_t* pos, move_t move)
         (good_tactic ? good_tactic_score : bad_tactic_score);
 }
 
+/*
+ * Look up the history score for a quiet move. History values can drift far
+ * below zero, so they're clamped to keep them inside the range of a move score.
+ */
+static int history_score(const move_selector_t* sel, move_t move)
+{
+    const float min_history = -1000.0 * MAX_HISTORY;
+    return (int)MAX(sel->data->history.history[history_index(move)],
+            min_history);
+}
+
+/*
+ * Node counts are used as move scores at the root and at pv nodes, but they
+ * can outgrow a move score in long searches. Find how far the counts need to
+ * be shifted down so that the largest one fits.
+ */
+static int node_count_shift(uint64_t max_nodes)
+{
+    int shift = 0;
+    while ((max_nodes >> shift) >= INT_MAX) ++shift;
+    return shift;
+}
+
 /*
  * Sort moves at the root based on total nodes searched under that move.
  * Since the moves are sorted into position, |sel->scores| is not used to
@@ -352,17 +609,22 @@ static int64_t score_tactical_move(position_t* pos, move_t move)
  */
 static void sort_root_moves(move_selector_t* sel)
 {
+    uint64_t max_nodes = 0;
+    for (int i=0; sel->data->root_moves[i].move != NO_MOVE; ++i) {
+        max_nodes = MAX(max_nodes, sel->data->root_moves[i].nodes);
+    }
+    const int shift = node_count_shift(max_nodes);
     int i;
-    for (i=0; root_data.root_moves[i].move != NO_MOVE; ++i) {
-        sel->moves[i] = root_data.root_moves[i].move;
+    for (i=0; sel->data->root_moves[i].move != NO_MOVE; ++i) {
+        sel->moves[i] = sel->data->root_moves[i].move;
         if (sel->moves[i] == sel->hash_move[0]) {
-            sel->scores[i] = INT64_MAX;
+            sel->scores[i] = INT_MAX;
         } else if (sel->depth <= 2*PLY) {
-            sel->scores[i] = root_data.root_moves[i].qsearch_score;
+            sel->scores[i] = sel->data->root_moves[i].qsearch_score;
         } else if (options.multi_pv > 1) {
-            sel->scores[i] = root_data.root_moves[i].score;
+            sel->scores[i] = sel->data->root_moves[i].score;
         } else {
-            sel->scores[i] = (int64_t)root_data.root_moves[i].nodes;
+            sel->scores[i] = (int)(sel->data->root_moves[i].nodes >> shift);
         }
     }
     sel->moves_end = i;
@@ -371,12 +633,13 @@ static void sort_root_moves(move_selector_t* sel)
 }
 
 /*
- * Combined score-and-sort for normal search nodes.
+ * Combined score-and-sort for normal search nodes. The sort itself happens
+ * incrementally, in |pick_move|.
  */
 static void sort_moves(move_selector_t* sel)
 {
     score_moves(sel);
-    sort_move_list(sel);
+    sel->sorted = false;
 }
 
 /*
@@ -385,19 +648,21 @@ static void sort_moves(move_selector_t* sel)
 static void sort_qsearch_moves(move_selector_t* sel)
 {
     score_qsearch_moves(sel);
-    sort_move_list(sel);
+    sel->sorted = false;
 }
 
 /*
- * Selection-sort the move list according to the associated scores.
+ * Insertion-sort the unselected part of the move list according to the
+ * associated scores.
  */
 static void sort_move_list(move_selector_t* sel)
 {
-    for (int i=0; sel->moves[i] != NO_MOVE; ++i) {
+    const int begin = sel->current_move_index;
+    for (int i=begin; sel->moves[i] != NO_MOVE; ++i) {
         move_t move = sel->moves[i];
-        int64_t score = sel->scores[i];
+        int score = sel->scores[i];
         int j = i-1;
-        while (j >= 0 && sel->scores[j] < score) {
+        while (j >= begin && sel->scores[j] < score) {
             sel->scores[j+1] = sel->scores[j];
             sel->moves[j+1] = sel->moves[j];
             --j;
@@ -407,6 +672,40 @@ static void sort_move_list(move_selector_t* sel)
     }
 }
 
+/*
+ * Make sure the next move in the list is the best one left. Until the pick
+ * limit is reached this just finds the best remaining move and moves it to
+ * the front, shifting the moves it passes over so that ties come out in the
+ * same order a full sort would give them. After that, the rest of the list
+ * is sorted.
+ */
+static void pick_move(move_selector_t* sel)
+{
+    if (sel->sorted) return;
+    const int index = sel->current_move_index;
+    if (index >= sel->moves_end) return;
+    sel->data->stats.move_picks[sel->generator]++;
+    if (index >= pick_limit[sel->generator]) {
+        sel->data->stats.move_sorts[sel->generator]++;
+        sort_move_list(sel);
+        sel->sorted = true;
+        return;
+    }
+    move_t* moves = sel->moves;
+    int* scores = sel->scores;
+    int best = index;
+    for (int i=index+1; i<sel->moves_end; ++i) {
+        if (scores[i] > scores[best]) best = i;
+    }
+    if (best == index) return;
+    const move_t best_move = moves[best];
+    const int best_score = scores[best];
+    memmove(moves+index+1, moves+index, (best-index)*sizeof(move_t));
+    memmove(scores+index+1, scores+index, (best-index)*sizeof(int));
+    moves[index] = best_move;
+    scores[index] = best_score;
+}
+
 /*
  * Add the move to a list of deferred moves, which will be retried in the
  * last phase. Currently this isn't used; I haven't found a deferment scheme
@@ -418,6 +717,7 @@ bool defer_move(move_selector_t* sel, move_t move)
     assert(move == sel->moves[sel->current_move_index]);
     if (*sel->phase == PHASE_DEFERRED ||
             *sel->phase == PHASE_TRANS ||
+            sel->num_deferred_moves == MAX_DEFERRED_MOVES ||
             sel->scores[sel->current_move_index] > MAX_HISTORY) return false;
     sel->deferred_moves[sel->num_deferred_moves++] = move;
     sel->deferred_moves[sel->num_deferred_moves] = NO_MOVE;
@@ -433,6 +733,7 @@ struct {
 } pv_cache_stats;
 
 static move_cache_t* pv_cache = NULL;
+static table_memory_t pv_cache_memory;
 static int num_buckets;
 
 /*
@@ -450,9 +751,11 @@ void init_pv_cache(const int max_bytes)
         size <<= 1;
         num_buckets <<= 1;
     }
-    if (pv_cache != NULL) free(pv_cache);
-    pv_cache = (move_cache_t*)malloc(size);
-    assert(pv_cache);
+    free_table_memory(&pv_cache_memory);
+    bool allocated = alloc_table_memory(&pv_cache_memory, size);
+    assert(allocated);
+    (void)allocated;
+    pv_cache = (move_cache_t*)pv_cache_memory.base;
     clear_pv_cache();
 }
 
@@ -484,11 +787,11 @@ static move_cache_t* get_pv_move_list(const position_t* pos)
  */
 void add_pv_move(move_selector_t* sel, move_t move, int64_t nodes)
 {
-    if (sel->generator == ESCAPE_GEN) return;
+    if (!sel->pv_list) return;
     assert2(is_pseudo_move_legal(sel->pos, move));
     assert2(is_move_legal(sel->pos, move));
-    sel->pv_moves[sel->pv_index] = move;
-    sel->pv_nodes[sel->pv_index++] = nodes;
+    sel->pv_list->moves[sel->pv_index] = move;
+    sel->pv_list->nodes[sel->pv_index++] = nodes;
     assert(sel->pv_index == sel->moves_so_far);
 }
 
@@ -497,16 +800,16 @@ void add_pv_move(move_selector_t* sel, move_t move, int64_t nodes)
  */
 void commit_pv_moves(move_selector_t* sel)
 {
-    if (sel->generator == ESCAPE_GEN) return;
+    if (!sel->pv_list) return;
     assert(sel->pv_index == sel->moves_so_far);
     move_cache_t* pv_cache = get_pv_move_list(sel->pos);
     pv_cache->key = sel->pos->hash;
     int i;
     for (i=0; i < sel->pv_index; ++i) {
-        assert(sel->pv_moves[i]);
-        assert2(is_move_legal(sel->pos, sel->pv_moves[i]));
-        pv_cache->moves[i] = sel->pv_moves[i];
-        pv_cache->nodes[i] = sel->pv_nodes[i];
+        assert(sel->pv_list->moves[i]);
+        assert2(is_move_legal(sel->pos, sel->pv_list->moves[i]));
+        pv_cache->moves[i] = sel->pv_list->moves[i];
+        pv_cache->nodes[i] = sel->pv_list->nodes[i];
     }
     pv_cache->moves[i] = NO_MOVE;
 }
@@ -27,19 +27,39 @@ typedef enum {
     PHASE_DEFERRED,
 } selection_phase_t;
 
+#define MAX_DEFERRED_MOVES  16
+
+/*
+ * A move cache entry records the number of nodes searched under each move at
+ * a pv node. The same structure is used to gather counts while the node is
+ * being searched, so that the selector itself doesn't have to carry them.
+ */
+typedef struct {
+    hashkey_t key;
+    move_t moves[256];
+    int64_t nodes[256];
+} move_cache_t;
+
+/*
+ * Move selectors live on the stack at every ply, so keep them small. Scores
+ * are 32 bits, and pv node counts are kept in a per-ply list outside the
+ * selector.
+ */
 typedef struct {
     selection_phase_t* phase;
     move_t* moves;
-    int64_t* scores;
+    int* scores;
     move_t base_moves[256];
-    move_t deferred_moves[256];
+    int base_scores[256];
+    move_t deferred_moves[MAX_DEFERRED_MOVES+1];
     int num_deferred_moves;
-    int64_t base_scores[256];
-    move_t pv_moves[256];
-    int64_t pv_nodes[256];
+    move_cache_t* pv_list;
     int pv_index;
     int moves_end;
     int current_move_index;
+    bool sorted;
+    int tactics_end;
+    int bad_tactics_index;
     generation_t generator;
     move_t hash_move[2];
     move_t mate_killer;
@@ -49,6 +69,7 @@ typedef struct {
     int quiet_moves_so_far;
     float depth;
     position_t* pos;
+    search_data_t* data;
     bool single_reply;
 } move_selector_t;
 
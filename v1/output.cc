@@ -52,7 +52,7 @@ static void print_pv(search_data_t* data, int ordinal, int index)
     const int score = data->root_moves[index].score;
     // note: use time+1 to avoid divide-by-zero
     const int time = elapsed_time(&data->timer) + 1;
-    const uint64_t nodes = data->nodes_searched;
+    const uint64_t nodes = total_nodes_searched(data);
 
     if (options.verbosity) {
         char sanpv[1024];
@@ -81,13 +81,15 @@ static void print_pv(search_data_t* data, int ordinal, int index)
         // If our pv is shortened by a hash hit,
         // try to get more moves from the hash table.
         position_t pos;
+        hash_history_t hash_history;
         undo_info_t undo;
         copy_position(&pos, &data->root_pos);
+        attach_hash_history(&pos, &hash_history);
         for (int i=0; pv[i] != NO_MOVE; ++i) do_move(&pos, pv[i], &undo);
 
-        transposition_entry_t* entry;
+        transposition_entry_t trans_buf, *entry;
         while (moves < depth) {
-            entry = get_transposition(&pos);
+            entry = get_transposition(&pos, &trans_buf);
             if (!entry || !is_move_legal(&pos, entry->move)) break;
             print_coord_move(entry->move);
             do_move(&pos, entry->move, &undo);
@@ -185,10 +187,43 @@ void print_search_stats(const search_data_t* search_data)
     if (search_data->obvious_move) {
         printf("info string this move seemed obvious\n");
     }
+    const search_stats_t* stats = &search_data->stats;
+    if (stats->staged_nodes) {
+        uint64_t early = stats->staged_nodes - stats->quiet_generations;
+        printf("info string staged nodes %"PRIu64" done before quiets "
+                "%"PRIu64" (%.2f%%) moves generated per node %.2f\n",
+                stats->staged_nodes, early,
+                (float)early / stats->staged_nodes*100.,
+                (float)stats->moves_generated / stats->staged_nodes);
+    }
+    static const char* generator_names[NUM_GENERATORS] = {
+        "root", "pv", "non-pv", "evasion", "qsearch", "qsearch-checks"
+    };
+    for (int gen=0; gen<NUM_GENERATORS; ++gen) {
+        const uint64_t nodes = stats->selector_nodes[gen];
+        if (!nodes) continue;
+        printf("info string %s nodes %"PRIu64" moves per node %.2f "
+                "picks %"PRIu64" sorts %"PRIu64" moves consumed ",
+                generator_names[gen], nodes,
+                (float)stats->moves_selected[gen] / nodes,
+                stats->move_picks[gen], stats->move_sorts[gen]);
+        // The fraction of nodes that took at least i+1 moves.
+        for (int i=0; i<=HIST_BUCKETS; ++i) {
+            float pct = (float)stats->moves_consumed[gen][i] / nodes;
+            printf("%.2f ", pct);
+            if (pct < 0.005) break;
+        }
+        printf("\n");
+    }
     int high = search_data->stats.root_fail_highs;
     int low = search_data->stats.root_fail_lows;
     printf("info string root fail highs %d fail lows %d exact results %d\n",
             high, low, depth_to_index(search_data->current_depth)-high-low);
+    for (int i=0; i<get_num_threads(); ++i) {
+        const search_data_t* data = i ? get_thread_data(i) : search_data;
+        printf("info string thread %d nodes %"PRIu64" splits %d\n",
+                i, data->nodes_searched, data->stats.splits);
+    }
 }
 
 /*
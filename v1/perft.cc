@@ -4,8 +4,47 @@
 #include <stdio.h>
 #include <string.h>
 
+typedef int (*legal_generator_t)(position_t* pos, move_t* moves);
+
+// Subtree counts are memoised in a table shared by all perft threads, keyed
+// by position hash and remaining depth. Each slot stores its key xor'd with
+// the count, so that a slot torn by two threads writing at once fails to
+// verify instead of handing back the wrong count.
+typedef struct {
+    uint64_t check;
+    uint64_t nodes;
+} perft_slot_t;
+
+#define PERFT_TABLE_BYTES   (32<<20)
+#define perft_key(hash, depth) \
+    ((hash) ^ ((uint64_t)(depth) * 0x9e3779b97f4a7c15ull))
+
+static perft_slot_t* perft_table = NULL;
+static table_memory_t perft_table_memory;
+static size_t perft_table_mask;
+
+// One unit of parallel perft work: the subtree below one or two moves from
+// the root. Threads take jobs from the list in order until it's empty.
+typedef struct {
+    move_t moves[2];
+    int root_index;
+    uint64_t nodes;
+} perft_job_t;
+
+typedef struct {
+    const position_t* root;
+    int depth;
+    perft_job_t* jobs;
+    int num_jobs;
+    int next_job;
+    lock_t lock;
+} perft_work_t;
+
 static uint64_t full_search(position_t* pos, int depth);
-static uint64_t divide(position_t* pos, int depth);
+static uint64_t generator_search(position_t* pos,
+        int depth,
+        legal_generator_t generate);
+static uint64_t parallel_perft(position_t* pos, int depth, bool div);
 
 /*
  * Execute a series of perft tests from a given file. The test file consists of
@@ -16,6 +55,13 @@ static uint64_t divide(position_t* pos, int depth);
  * rnbqkbnr/pppppppp/8/8/8/8/PPPPPPPP/RNBQKBNR w KQkq - 0 1 ;D1 20 ;D2 400
  * The test results and elapsed time are printed to stdout.
  *
+ * Each test is run four times: through the move selector, directly through
+ * the bitboard legal move generator, through the reference generator in
+ * move_generation.cc, and through the hashed parallel perft using all search
+ * threads. All four have to agree with the expected answer for the test to
+ * pass, and the time taken by each is reported so that the generators can be
+ * compared.
+ *
  * This file format and the associated test files are taken from ROCE. For
  * more information, see http://www.rocechess.ch/rocee.html.
  */
@@ -24,8 +70,12 @@ void perft_testsuite(char* filename)
     char test_storage[4096];
     char* test = test_storage;
     position_t pos;
-    milli_timer_t perft_timer;
+    hash_history_t hash_history;
+    milli_timer_t perft_timer, bitboard_timer, reference_timer, parallel_timer;
     init_timer(&perft_timer);
+    init_timer(&bitboard_timer);
+    init_timer(&reference_timer);
+    init_timer(&parallel_timer);
     FILE* test_file = fopen(filename, "r");
     if (!test_file) {
         printf("Couldn't open perft test file %s: %s\n",
@@ -36,6 +86,7 @@ void perft_testsuite(char* filename)
     while (fgets(test, 4096, test_file)) {
         char* fen = strsep(&test, ";");
         set_position(&pos, fen);
+        attach_hash_history(&pos, &hash_history);
         printf("Test %d: %s\n", total_tests+1, fen);
         bool failure = false;
         do {
@@ -45,13 +96,35 @@ void perft_testsuite(char* filename)
             start_timer(&perft_timer);
             uint64_t result = full_search(&pos, depth);
             int time = stop_timer(&perft_timer);
+            start_timer(&bitboard_timer);
+            uint64_t bitboard_result =
+                generator_search(&pos, depth, generate_legal_moves);
+            int bitboard_time = stop_timer(&bitboard_timer);
+            start_timer(&reference_timer);
+            uint64_t reference_result =
+                generator_search(&pos, depth, generate_reference_legal_moves);
+            int reference_time = stop_timer(&reference_timer);
+            start_timer(&parallel_timer);
+            uint64_t parallel_result =
+                parallel_perft(&pos, depth, false);
+            int parallel_time = stop_timer(&parallel_timer);
             printf("\tDepth %d: %15"PRIu64, depth, result);
             if (result != correct_answer) {
                 failure = true;
                 printf(" expected %15"PRIu64" -- FAIL",
                         correct_answer);
+            } else if (bitboard_result != correct_answer ||
+                    reference_result != correct_answer ||
+                    parallel_result != correct_answer) {
+                failure = true;
+                printf(" bitboard %"PRIu64" reference %"PRIu64
+                        " parallel %"PRIu64" -- FAIL",
+                        bitboard_result, reference_result, parallel_result);
             } else printf(" -- SUCCESS");
-            printf(" / %.2fs\n", time/1000.0);
+            printf(" / %.2fs (bitboard %.2fs, reference %.2fs, "
+                    "parallel %.2fs)\n",
+                    time/1000.0, bitboard_time/1000.0, reference_time/1000.0,
+                    parallel_time/1000.0);
         } while ((test = strchr(test, ';') + 1) != (char*)1);
         ++total_tests;
         if (!failure) ++correct_tests;
@@ -59,91 +132,225 @@ void perft_testsuite(char* filename)
     }
     printf("Tests completed. %d/%d tests passed in %.2fs.\n",
             correct_tests, total_tests, elapsed_time(&perft_timer)/1000.0);
+    printf("Generator time: bitboard %.2fs, reference %.2fs, "
+            "parallel %.2fs (%d threads).\n",
+            elapsed_time(&bitboard_timer)/1000.0,
+            elapsed_time(&reference_timer)/1000.0,
+            elapsed_time(&parallel_timer)/1000.0, get_num_threads());
 }
 
 /*
  * Determine the total number of nodes at depth |depth| in the game tree
- * rooted at |position|. If |div| is true, report numbers for each current
- * legal move. The number of nodes found and elapsed time are reported.
+ * rooted at |position|, splitting the work between |threads| threads. If
+ * |div| is true, report numbers for each current legal move. The number of
+ * nodes found, elapsed time, and speed are reported.
  */
-uint64_t perft(position_t* position, int depth, bool div)
+uint64_t perft(position_t* position, int depth, int threads, bool div)
 {
     milli_timer_t perft_timer;
     init_timer(&perft_timer);
+    int saved_threads = get_num_threads();
+    if (threads != saved_threads) init_threads(threads);
     start_timer(&perft_timer);
-    uint64_t nodes;
-    if (div) {
-        nodes = divide(position, depth);
-    } else {
-        nodes = full_search(position, depth);
-        printf("%"PRIu64" nodes", nodes);
-    }
-    stop_timer(&perft_timer);
-    printf(", elapsed time %d ms\n", elapsed_time(&perft_timer));
+    uint64_t nodes = parallel_perft(position, depth, div);
+    int time = stop_timer(&perft_timer);
+    printf("%"PRIu64" nodes, elapsed time %d ms, %.2f Mnps, %d threads\n",
+            nodes, time, nodes / (MAX(time, 1) * 1000.0), get_num_threads());
+    if (threads != saved_threads) init_threads(saved_threads);
     return nodes;
 }
 
 /*
- * Print the number of nodes descended from each legal move in the given
- * position at depth |depth|, returning the total number of nodes.
+ * Do a full search of the position tree rooted at |pos|, to depth |depth|.
+ * This does no evaluation whatsoever, it just counts nodes.
  */
-static uint64_t divide(position_t* pos, int depth)
+static uint64_t full_search(position_t* pos, int depth)
 {
+    if (depth <= 0) return 1;
     move_t move_list[256];
     move_t* current_move = move_list;
     int num_moves = 0;
     move_selector_t selector;
-    init_move_selector(&selector, pos, PV_GEN, NULL, NO_MOVE, 0, 0);
+    init_move_selector(&selector, &root_data,
+            pos, PV_GEN, NULL, NO_MOVE, 0, 0);
     for (move_t move = select_move(&selector); move != NO_MOVE;
             move = select_move(&selector), ++num_moves) {
         move_list[num_moves] = move;
     }
     move_list[num_moves] = NO_MOVE;
 
-    uint64_t child_nodes, total_nodes=0;
-    char coord_move[7];
+    if (depth == 1) return num_moves;
+
+    uint64_t nodes = 0;
     while (*current_move) {
         undo_info_t undo;
         do_move(pos, *current_move, &undo);
-        child_nodes = full_search(pos, depth-1);
-        total_nodes += child_nodes;
+        nodes += full_search(pos, depth-1);
         undo_move(pos, *current_move, &undo);
-        move_to_coord_str(*current_move, coord_move);
-        printf("%s: %8"PRIu64"\n", coord_move, child_nodes);
         ++current_move;
     }
-    printf("%d moves, %"PRIu64" nodes", num_moves, total_nodes);
-    return total_nodes;
+    return nodes;
 }
 
+
 /*
- * Do a full search of the position tree rooted at |pos|, to depth |depth|.
- * This does no evaluation whatsoever, it just counts nodes.
+ * Like |full_search|, but take moves straight from the legal move generator
+ * |generate| instead of going through a move selector.
  */
-static uint64_t full_search(position_t* pos, int depth)
+static uint64_t generator_search(position_t* pos,
+        int depth,
+        legal_generator_t generate)
 {
     if (depth <= 0) return 1;
     move_t move_list[256];
-    move_t* current_move = move_list;
-    int num_moves = 0;
-    move_selector_t selector;
-    init_move_selector(&selector, pos, PV_GEN, NULL, NO_MOVE, 0, 0);
-    for (move_t move = select_move(&selector); move != NO_MOVE;
-            move = select_move(&selector), ++num_moves) {
-        move_list[num_moves] = move;
+    int num_moves = generate(pos, move_list);
+    if (depth == 1) return num_moves;
+
+    uint64_t nodes = 0;
+    for (move_t* move=move_list; *move; ++move) {
+        undo_info_t undo;
+        do_move(pos, *move, &undo);
+        nodes += generator_search(pos, depth-1, generate);
+        undo_move(pos, *move, &undo);
     }
-    move_list[num_moves] = NO_MOVE;
+    return nodes;
+}
 
-    if (depth == 1) return num_moves;
+/*
+ * Allocate the perft table the first time it's needed, and wipe it.
+ */
+static void clear_perft_table(void)
+{
+    if (!perft_table) {
+        bool allocated =
+            alloc_table_memory(&perft_table_memory, PERFT_TABLE_BYTES);
+        assert(allocated);
+        (void)allocated;
+        perft_table = (perft_slot_t*)perft_table_memory.base;
+        perft_table_mask = PERFT_TABLE_BYTES / sizeof(perft_slot_t) - 1;
+    }
+    memset(perft_table, 0, PERFT_TABLE_BYTES);
+}
+
+/*
+ * Count the leaves of the tree rooted at |pos| to depth |depth|. Moves come
+ * straight from the bitboard legal move generator, the last ply is counted
+ * without being played, and the counts of subtrees at least two plies deep
+ * are stored in the perft table.
+ */
+static uint64_t hashed_search(position_t* pos, int depth)
+{
+    if (depth <= 0) return 1;
+    move_t move_list[256];
+    if (depth == 1) return generate_legal_moves(pos, move_list);
+
+    const uint64_t key = perft_key(pos->hash, depth);
+    perft_slot_t* slot = &perft_table[key & perft_table_mask];
+    const uint64_t check = slot->check, cached_nodes = slot->nodes;
+    if ((check ^ cached_nodes) == key) return cached_nodes;
 
+    generate_legal_moves(pos, move_list);
     uint64_t nodes = 0;
-    while (*current_move) {
+    for (move_t* move=move_list; *move; ++move) {
         undo_info_t undo;
-        do_move(pos, *current_move, &undo);
-        nodes += full_search(pos, depth-1);
-        undo_move(pos, *current_move, &undo);
-        ++current_move;
+        do_move(pos, *move, &undo);
+        nodes += hashed_search(pos, depth-1);
+        undo_move(pos, *move, &undo);
     }
+    slot->check = key ^ nodes;
+    slot->nodes = nodes;
     return nodes;
 }
 
+/*
+ * Work through jobs from the shared list until there are none left. Run on
+ * every thread at once by |run_on_all_threads|.
+ */
+static void perft_worker(int thread_id, int num_threads, void* arg)
+{
+    (void)thread_id;
+    (void)num_threads;
+    perft_work_t* work = (perft_work_t*)arg;
+    position_t pos;
+    hash_history_t hash_history;
+    while (true) {
+        lock_grab(work->lock);
+        int index = work->next_job++;
+        lock_release(work->lock);
+        if (index >= work->num_jobs) break;
+
+        perft_job_t* job = &work->jobs[index];
+        copy_position(&pos, work->root);
+        attach_hash_history(&pos, &hash_history);
+        int depth = work->depth;
+        undo_info_t undo;
+        for (int i=0; i<2 && job->moves[i]; ++i, --depth) {
+            do_move(&pos, job->moves[i], &undo);
+        }
+        job->nodes = hashed_search(&pos, depth);
+    }
+}
+
+/*
+ * Count the leaves of the tree rooted at |pos| to depth |depth| using all
+ * search threads and the perft table. The tree is cut into one job
+ * per pair of moves from the root, or per root move for shallow searches,
+ * so that there are enough jobs to keep every thread busy until the end. If
+ * |div| is true, print the count for each root move.
+ */
+static uint64_t parallel_perft(position_t* pos, int depth, bool div)
+{
+    if (depth <= 0) return 1;
+    clear_perft_table();
+    move_t root_moves[256];
+    int num_root_moves = generate_legal_moves(pos, root_moves);
+
+    perft_job_t* jobs = (perft_job_t*)malloc(
+            MAX(num_root_moves, 1) * 256 * sizeof(perft_job_t));
+    int num_jobs = 0;
+    for (int i=0; i<num_root_moves; ++i) {
+        // A root move with no replies still gets a job, which counts zero.
+        move_t replies[256] = { NO_MOVE };
+        int num_replies = 1;
+        if (depth > 2) {
+            undo_info_t undo;
+            do_move(pos, root_moves[i], &undo);
+            num_replies = MAX(generate_legal_moves(pos, replies), 1);
+            undo_move(pos, root_moves[i], &undo);
+        }
+        for (int j=0; j<num_replies; ++j) {
+            perft_job_t* job = &jobs[num_jobs++];
+            job->moves[0] = root_moves[i];
+            job->moves[1] = replies[j];
+            job->root_index = i;
+            job->nodes = 0;
+        }
+    }
+
+    perft_work_t work;
+    work.root = pos;
+    work.depth = depth;
+    work.jobs = jobs;
+    work.num_jobs = num_jobs;
+    work.next_job = 0;
+    lock_init(work.lock);
+    run_on_all_threads(perft_worker, &work);
+    lock_destroy(work.lock);
+
+    uint64_t root_nodes[256] = { 0 };
+    uint64_t total_nodes = 0;
+    for (int i=0; i<num_jobs; ++i) {
+        root_nodes[jobs[i].root_index] += jobs[i].nodes;
+        total_nodes += jobs[i].nodes;
+    }
+    free(jobs);
+    if (div) {
+        char coord_move[7];
+        for (int i=0; i<num_root_moves; ++i) {
+            move_to_coord_str(root_moves[i], coord_move);
+            printf("%s: %8"PRIu64"\n", coord_move, root_nodes[i]);
+        }
+        printf("%d moves, ", num_root_moves);
+    }
+    return total_nodes;
+}
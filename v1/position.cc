@@ -44,6 +44,28 @@ void copy_position(position_t* dst, const position_t* src)
     check_board_validity(dst);
 }
 
+/*
+ * Keep the hash history for |pos| in |history|. Copies share their source's
+ * history, so anything that makes moves in a copy while the original is
+ * still in use needs to give it its own storage first. Only the entries
+ * that |is_repetition| can still look at are carried over, and the
+ * repetition filter is rebuilt to count just those.
+ */
+void attach_hash_history(position_t* pos, hash_history_t* history)
+{
+    assert(pos->hash_history || !pos->ply);
+    const int start = pos->ply - MIN(pos->fifty_move_counter, pos->ply);
+    if (pos->hash_history && pos->hash_history != history) {
+        memcpy(history->hashes + start, pos->hash_history->hashes + start,
+                (pos->ply - start) * sizeof(hashkey_t));
+    }
+    memset(history->filter, 0, sizeof(history->filter));
+    for (int i=start; i<pos->ply; ++i) {
+        history->filter[repetition_filter_index(history->hashes[i])]++;
+    }
+    pos->hash_history = history;
+}
+
 /*
  * Create a copy of |src| with the board flipped, inverting black and white.
  */
@@ -359,8 +381,16 @@ bool is_plausible_move_legal(position_t* pos, move_t move)
     square_t from = get_move_from(move);
     color_t side = piece_color(piece);
     // Make sure source and destination squares are legal.
+    if (side != pos->side_to_move) return false;
     if (pos->board[from] != piece) return false;
     if (pos->board[to] != capture && !is_move_enpassant(move)) return false;
+    if (is_move_enpassant(move) && to != pos->ep_square) return false;
+
+    // Make sure double pawn pushes aren't blocked. Moves from the
+    // transposition table may have been written by another thread for a
+    // different position, so we can't assume much about them.
+    if (piece_type(piece) == PAWN && to - from == 2*pawn_push[side] &&
+            pos->board[from + pawn_push[side]] != EMPTY) return false;
 
     // Make sure nothing's in the way of sliding pieces.
     if (piece_slide_type(piece) != NONE) {
@@ -458,22 +488,15 @@ bool is_pseudo_move_legal(position_t* pos, move_t move)
     // Also note: This is more complicated for Chess960,
     // since the rook may be shielding the king from check.
     if (options.chess960 && is_move_castle(move)) {
-        piece_t my_r = create_piece(pos->side_to_move, ROOK);
-        if (is_move_castle_long(move)) {
-            square_t my_qr = queen_rook_home + A8*pos->side_to_move;
-            assert(pos->board[my_qr] == my_r);
-            pos->board[my_qr] = EMPTY;
-            bool castle_ok = !is_square_attacked(pos, to, flip_color(side));
-            pos->board[my_qr] = my_r;
-            return castle_ok;
-        }
-        assert(is_move_castle_short(move));
-        square_t my_kr = king_rook_home + A8*pos->side_to_move;
-        assert(pos->board[my_kr] == my_r);
-        pos->board[my_kr] = EMPTY;
-        bool castle_ok = !is_square_attacked(pos, to, flip_color(side));
-        pos->board[my_kr] = my_r;
-        return castle_ok;
+        square_t my_r = is_move_castle_long(move) ?
+            queen_rook_home + A8*pos->side_to_move :
+            king_rook_home + A8*pos->side_to_move;
+        assert(is_move_castle_long(move) || is_move_castle_short(move));
+        assert(pos->board[my_r] == create_piece(pos->side_to_move, ROOK));
+        const bitboard_t occupied = (pos->occupied_bb[WHITE] |
+                pos->occupied_bb[BLACK]) & ~sq_bit(my_r);
+        return !(attackers_to(pos, to, occupied) &
+                pos->occupied_bb[flip_color(side)]);
     }
     if (piece_is_type(piece, KING)) return !is_square_attacked(pos, to, flip_color(side));
 
@@ -499,10 +522,12 @@ bool is_pseudo_move_legal(position_t* pos, move_t move)
  */
 bool is_repetition(const position_t* pos)
 {
+    const hash_history_t* history = pos->hash_history;
+    if (!history->filter[repetition_filter_index(pos->hash)]) return false;
     int max_age = MIN(pos->fifty_move_counter, pos->ply);
     for (int age = 2; age < max_age; age += 2) {
         assert(pos->ply >= age);
-        if (pos->hash_history[pos->ply - age] == pos->hash) return true;
+        if (history->hashes[pos->ply - age] == pos->hash) return true;
     }
     return false;
 }
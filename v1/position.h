@@ -7,30 +7,53 @@ extern "C" {
 
 #define FEN_STARTPOS "rnbqkbnr/pppppppp/8/8/8/8/PPPPPPPP/RNBQKBNR w KQkq - 0 1"
 #define HASH_HISTORY_LENGTH  2048
+#define REPETITION_FILTER_SIZE  4096
+#define repetition_filter_index(hash) \
+    ((int)((hash) & (REPETITION_FILTER_SIZE - 1)))
 
+/*
+ * Hashes of the positions leading up to a position, indexed by ply. The
+ * filter counts how many of the recorded hashes fall into each bucket, so
+ * that |is_repetition| can rule out most positions without scanning back
+ * through the history. Only hashes since the last attach_hash_history are
+ * counted.
+ */
 typedef struct {
-    piece_t _board_storage[256];        // 16x16 padded board
+    hashkey_t hashes[HASH_HISTORY_LENGTH];
+    uint8_t filter[REPETITION_FILTER_SIZE];
+} hash_history_t;
+
+typedef struct {
+    // Fields used at every node come first, so that they share the first
+    // couple of cache lines.
     piece_t* board;                     // 0x88 board in middle 128 slots
-    int piece_index[128];               // index of each piece in pieces
-    square_t pieces[2][32];
-    square_t pawns[2][16];
-    int num_pieces[2];
-    int num_pawns[2];
-    int piece_count[16];
+    hashkey_t hash;
     color_t side_to_move;
-    move_t prev_move;
     square_t ep_square;
-    int fifty_move_counter;
-    int ply;
-    int material_eval[2];
-    score_t piece_square_eval[2];
-    castle_rights_t castle_rights;
     uint8_t is_check;
+    castle_rights_t castle_rights;
     square_t check_square;
-    hashkey_t hash;
+    move_t prev_move;
+    int fifty_move_counter;
+    int ply;
+    int num_pieces[2];
+    int num_pawns[2];
+    bitboard_t occupied_bb[2];          // squares occupied by each side
+    bitboard_t piece_bb[16];            // squares occupied by each piece
+    square_t pieces[2][32];
+    square_t pawns[2][16];
     hashkey_t pawn_hash;
     hashkey_t material_hash;
-    hashkey_t hash_history[HASH_HISTORY_LENGTH];
+    int material_eval[2];
+    score_t piece_square_eval[2];
+    int piece_count[16];
+    int piece_index[128];               // index of each piece in pieces
+    piece_t _board_storage[256];        // 16x16 padded board
+
+    // Hashes of the positions leading up to this one. The storage belongs
+    // to whoever is making moves in the position (usually a search thread),
+    // so that copying a position stays cheap. See attach_hash_history.
+    hash_history_t* hash_history;
 } position_t;
 
 typedef struct {
@@ -38,29 +38,47 @@ static const int razor_qmargin[] = { 125, 125, 300, 300 };
 static search_result_t root_search(search_data_t* search_data,
         int alpha,
         int beta);
-static int search(position_t* pos,
+static int search(search_data_t* data,
+        position_t* pos,
         search_node_t* search_node,
         int ply,
         int alpha,
         int beta,
         float depth);
-static int quiesce(position_t* pos,
+static int quiesce(search_data_t* data,
+        position_t* pos,
         search_node_t* search_node,
         int ply,
         int alpha,
         int beta,
         float depth);
-static uint64_t get_root_node_count(move_t move);
+static uint64_t get_root_node_count(search_data_t* data, move_t move);
+static bool split_search(search_data_t* data,
+        position_t* pos,
+        move_selector_t* sel,
+        search_node_t* search_node,
+        int ply,
+        float depth,
+        int* alpha,
+        int beta,
+        int lazy_score,
+        bool full_window,
+        bool mate_threat,
+        move_t* searched_moves,
+        int* num_searched_moves,
+        move_t* cutoff_move);
 
 /*
  * Zero out all search variables prior to starting a search. Leaves the
- * position and search options untouched.
+ * position and search options untouched, and moves the position's hash
+ * history into |data| if it isn't there already.
  */
 void init_search_data(search_data_t* data)
 {
     position_t root_pos_copy;
     copy_position(&root_pos_copy, &data->root_pos);
-    memset(data, 0, sizeof(search_data_t));
+    attach_hash_history(&root_pos_copy, &data->hash_history);
+    memset(data, 0, offsetof(search_data_t, hash_history));
     copy_position(&data->root_pos, &root_pos_copy);
     data->engine_status = ENGINE_IDLE;
     init_timer(&data->timer);
@@ -81,21 +99,34 @@ static void update_pv(move_t* dst, move_t* src, int ply, move_t move)
 
 /*
  * Every time a node is expanded, increment the node counter. Every
- * POLL_INTERVAL nodes, check for user input.
+ * POLL_INTERVAL nodes, check for user input. Only the main thread polls;
+ * helpers are stopped by the main thread. Independent searches just check
+ * their own limits, and check their node limit at every node so that it
+ * holds exactly.
  */
 static void open_node(search_data_t* data, int ply)
 {
-    if ((++data->nodes_searched & POLL_INTERVAL) == 0) {
+    ++data->nodes_searched;
+    if (data->independent) {
+        if (((data->nodes_searched & POLL_INTERVAL) == 0 ||
+                    (data->node_limit &&
+                     data->nodes_searched >= data->node_limit)) &&
+                should_stop_searching(data)) {
+            data->engine_status = ENGINE_ABORTED;
+        }
+    } else if ((data->nodes_searched & POLL_INTERVAL) == 0 &&
+            !data->thread_id) {
         if (should_stop_searching(data)) data->engine_status = ENGINE_ABORTED;
         uci_check_for_command();
         int so_far = elapsed_time(&data->timer);
         static int last_info = 0;
         if (so_far < 1000) {
             last_info = 0;
-        } else if (so_far - last_info > 1000) {
+        } else if (so_far - last_info > 1000 && !data->quiet) {
             last_info = so_far;
-            uint64_t nps = data->nodes_searched/so_far*1000;
-            printf("info time %d nodes %"PRIu64, so_far, data->nodes_searched);
+            uint64_t nodes = total_nodes_searched(data);
+            uint64_t nps = nodes/so_far*1000;
+            printf("info time %d nodes %"PRIu64, so_far, nodes);
             if (options.verbosity > 1) printf(" qnodes %"PRIu64" pvnodes %"
                     PRIu64, data->qnodes_searched, data->pvnodes_searched);
             printf(" nps %"PRIu64" hashfull %d\n", nps, get_hashfull());
@@ -115,6 +146,21 @@ static void open_qnode(search_data_t* data, int ply)
     open_node(data, ply);
 }
 
+/*
+ * Has this thread's search been stopped, either because the whole search was
+ * aborted or because a split point we're working under has been cut off?
+ */
+static bool is_search_stopped(search_data_t* data)
+{
+    if (data->engine_status == ENGINE_ABORTED) return true;
+    for (split_point_t* sp = data->split_point; sp; sp = sp->parent) {
+        if (sp->stop || sp->master->engine_status == ENGINE_ABORTED) {
+            return true;
+        }
+    }
+    return false;
+}
+
 /*
  * Should we terminate the search? This considers time and node limits, as
  * well as user input. This function is checked periodically during search.
@@ -139,8 +185,9 @@ bool should_stop_searching(search_data_t* data)
             so_far > 4*real_target) return true;
 
     // Respect node limits, if you're into that kind of thing.
-    if (data->node_limit &&
-            data->nodes_searched >= data->node_limit) return true;
+    uint64_t nodes = data->independent ?
+        data->nodes_searched : total_nodes_searched(data);
+    if (data->node_limit && nodes >= data->node_limit) return true;
     return false;
 }
 
@@ -198,7 +245,7 @@ static bool should_deepen(search_data_t* data)
     if (obvious_move_enabled && data->obvious_move &&
             data->depth_limit == MAX_SEARCH_PLY &&
             !data->node_limit && data->current_depth >= 7*PLY &&
-            get_root_node_count(data->obvious_move) >
+            get_root_node_count(data, data->obvious_move) >
             data->nodes_searched * 10 / 9) return false;
 
     // Allocate some extra time when the root score drops.
@@ -222,7 +269,8 @@ static bool should_deepen(search_data_t* data)
  * function provides a unified interface for calls to Scorpio bitbases and
  * Gaviota tablebases.
  */
-static bool check_eg_database(position_t* pos,
+static bool check_eg_database(search_data_t* data,
+        position_t* pos,
         float depth,
         int ply,
         int alpha,
@@ -231,14 +279,17 @@ static bool check_eg_database(position_t* pos,
 {
     // Bail out if there are too many pieces on the board or if time
     // constraints are an issue.
-    if ((root_data.time_limit && root_data.time_limit < 500) ||
+    if ((data->time_limit && data->time_limit < 500) ||
             pos->num_pieces[WHITE] + pos->num_pieces[BLACK] +
             pos->num_pawns[WHITE] + pos->num_pawns[BLACK] >
             options.max_egtb_pieces) return false;
     if (options.use_gtb) {
         // TODO: figure out when to use dtm instead of wdl.
         bool success = false;
-        if (options.root_in_gtb) {
+        if (data->thread_id && options.nonblocking_gtb) {
+            // The background prober only serves the main thread.
+            success = probe_gtb_soft(pos, score);
+        } else if (options.root_in_gtb) {
             success = probe_gtb_hard_dtm(pos, score);
         } else if (options.use_gtb_dtm) {
             if (options.nonblocking_gtb) {
@@ -254,7 +305,7 @@ static bool check_eg_database(position_t* pos,
             }
         }
         if (success) {
-            ++root_data.stats.egbb_hits;
+            ++data->stats.egbb_hits;
             return true;
         }
     } else if (options.use_scorpio_bb) {
@@ -264,7 +315,7 @@ static bool check_eg_database(position_t* pos,
         if (pos->fifty_move_counter != 0 &&
                 (ply <= 2*(depth_to_index(depth) + ply)/3)) return false;
         if (probe_scorpio_bb(pos, score, ply)) {
-            ++root_data.stats.egbb_hits;
+            ++data->stats.egbb_hits;
             return true;
         }
     }
@@ -304,13 +355,13 @@ static void store_root_data(search_data_t* data,
 /*
  * Get number of nodes searched for a root move in the last iteration.
  */
-static uint64_t get_root_node_count(move_t move)
+static uint64_t get_root_node_count(search_data_t* data, move_t move)
 {
     int i;
-    for (i=0; root_data.root_moves[i].move != move &&
-            root_data.root_moves[i].move != NO_MOVE; ++i) {}
-    assert(root_data.root_moves[i].move == move);
-    return root_data.root_moves[i].nodes;
+    for (i=0; data->root_moves[i].move != move &&
+            data->root_moves[i].move != NO_MOVE; ++i) {}
+    assert(data->root_moves[i].move == move);
+    return data->root_moves[i].nodes;
 }
 
 /*
@@ -339,6 +390,38 @@ static void record_failure(history_t* h, move_t move, int depth)
     h->failure[index]++;
 }
 
+/*
+ * Update history and killers after |move| causes a beta cutoff.
+ * |searched_moves| holds all moves searched at this node, with |move| last.
+ */
+static void record_cutoff(search_data_t* data,
+        search_node_t* search_node,
+        move_t move,
+        int score,
+        float depth,
+        move_t* searched_moves,
+        int num_searched_moves)
+{
+    if (!get_move_capture(move) &&
+            !get_move_promote(move)) {
+        record_success(&data->history, move, depth);
+        for (int i=0; i<num_searched_moves-1; ++i) {
+            move_t m = searched_moves[i];
+            assert(m != move);
+            if (!get_move_capture(m) && !get_move_promote(m)) {
+                record_failure(&data->history, m, depth);
+            }
+        }
+        if (move != search_node->killers[0]) {
+            search_node->killers[1] = search_node->killers[0];
+            search_node->killers[0] = move;
+        }
+    }
+    if (is_mate_score(score) && score > 0) {
+        search_node->mate_killer = move;
+    }
+}
+
 /*
  * History heuristic for forward pruning.
  */
@@ -382,17 +465,18 @@ static bool is_trans_cutoff_allowed(transposition_entry_t* entry,
 }
 
 /*
- * Initialize a move at the root with the score of its depth-1 search.
+ * Initialize a move at the root of |data| with the score of its depth-1
+ * search.
  */
-void init_root_move(root_move_t* root_move, move_t move)
+void init_root_move(search_data_t* data, root_move_t* root_move, move_t move)
 {
     memset(root_move, 0, sizeof(root_move_t));
     root_move->move = move;
     undo_info_t undo;
-    do_move(&root_data.root_pos, move, &undo);
-    root_move->qsearch_score = -quiesce(&root_data.root_pos,
-            root_data.search_stack, 1, mated_in(-1), mate_in(-1), 0.0);
-    undo_move(&root_data.root_pos, move, &undo);
+    do_move(&data->root_pos, move, &undo);
+    root_move->qsearch_score = -quiesce(data, &data->root_pos,
+            data->search_stack, 1, mated_in(-1), mate_in(-1), 0.0);
+    undo_move(&data->root_pos, move, &undo);
     root_move->pv[0] = move;
 }
 
@@ -415,14 +499,16 @@ void find_obvious_move(search_data_t* data)
     for (int i=0; r[i].move; ++i) {
         if (r[i].move == data->obvious_move) continue;
         if (r[i].qsearch_score + obvious_move_margin > best_score) {
-            if (options.verbosity && data->engine_status != ENGINE_PONDERING) {
+            if (options.verbosity && !data->quiet &&
+                    data->engine_status != ENGINE_PONDERING) {
                 printf("info string no obvious move\n");
             }
             data->obvious_move = NO_MOVE;
             return;
         }
     }
-    if (options.verbosity && data->engine_status != ENGINE_PONDERING) {
+    if (options.verbosity && !data->quiet &&
+            data->engine_status != ENGINE_PONDERING) {
         printf("info string candidate obvious move ");
         print_coord_move(data->obvious_move);
         printf("\n");
@@ -430,41 +516,12 @@ void find_obvious_move(search_data_t* data)
 }
 
 /*
- * Iterative deepening search of the root position. This is the external
- * function that is called by the console interface. For each depth,
- * |root_search| performs the actual search.
+ * Score the moves at the root of |search_data|, and look for one that's
+ * obviously best.
  */
-void deepening_search(search_data_t* search_data, bool ponder)
+static void init_root_moves(search_data_t* search_data)
 {
-    search_data->engine_status = ponder ? ENGINE_PONDERING : ENGINE_THINKING;
-    increment_transposition_age();
-    init_timer(&search_data->timer);
-    start_timer(&search_data->timer);
-
-    // Get a move out of the opening book if we can.
-    if (options.use_book &&
-            options.book_loaded &&
-            !search_data->infinite &&
-            !search_data->depth_limit &&
-            !search_data->node_limit &&
-            search_data->engine_status != ENGINE_PONDERING) {
-        move_t book_move = options.probe_book(&search_data->root_pos);
-        if (book_move) {
-            char move_str[7];
-            move_to_coord_str(book_move, move_str);
-            printf("info depth 0 nodes 0 score cp 0 pv %s\n", move_str);
-            printf("bestmove %s\n", move_str);
-            search_data->engine_status = ENGINE_IDLE;
-            return;
-        }
-    }
-
     position_t* pos = &search_data->root_pos;
-    options.root_in_gtb = (pos->num_pieces[WHITE] + pos->num_pieces[BLACK] +
-            pos->num_pawns[WHITE] + pos->num_pawns[BLACK] <=
-            options.max_egtb_pieces && options.use_gtb);
-    options.use_gtb_dtm = false;
-
     // If |search_data| already has a list of root moves, we search only
     // those moves. Otherwise, search everything. This allows support for the
     // uci searchmoves command.
@@ -472,17 +529,24 @@ void deepening_search(search_data_t* search_data, bool ponder)
         move_t moves[256];
         generate_legal_moves(pos, moves);
         for (int i=0; moves[i]; ++i) {
-            init_root_move(&search_data->root_moves[i], moves[i]);
+            init_root_move(search_data,
+                    &search_data->root_moves[i], moves[i]);
         }
     }
     find_obvious_move(search_data);
+}
 
-    int id_score = root_data.best_score = mated_in(-1);
+/*
+ * Search successively deeper iterations of the root position until the
+ * depth limit is reached or |should_deepen| says to stop. Returns the score
+ * of the last completed iteration.
+ */
+static int iterate_search(search_data_t* search_data)
+{
+    position_t* pos = &search_data->root_pos;
+    int id_score = search_data->best_score = mated_in(-1);
     int consecutive_fail_highs = 0;
     int consecutive_fail_lows = 0;
-    if (!search_data->depth_limit) {
-        search_data->depth_limit = MAX_SEARCH_PLY * PLY;
-    }
     for (search_data->current_depth=2*PLY;
             search_data->current_depth <= search_data->depth_limit;
             search_data->current_depth += PLY) {
@@ -506,7 +570,7 @@ void deepening_search(search_data_t* search_data, bool ponder)
             beta = consecutive_fail_highs > 2 ||
                 last_score > MIN_MATE_VALUE - MAX_SEARCH_PLY ?  mate_in(-1) :
                 last_score + aspire_high[consecutive_fail_highs];
-            if (options.verbosity) {
+            if (options.verbosity && !search_data->quiet) {
                 printf("info string aspiration window alpha %d beta %d\n",
                         alpha, beta);
             }
@@ -546,19 +610,71 @@ void deepening_search(search_data_t* search_data, bool ponder)
             consecutive_fail_lows = 0;
             consecutive_fail_highs = 0;
         }
-        options.use_gtb_dtm = (id_score < -MIN_MATE_VALUE + MAX_SEARCH_PLY ||
-                id_score > MIN_MATE_VALUE - MAX_SEARCH_PLY);
+        if (!search_data->independent) {
+            options.use_gtb_dtm =
+                (id_score < -MIN_MATE_VALUE + MAX_SEARCH_PLY ||
+                 id_score > MIN_MATE_VALUE - MAX_SEARCH_PLY);
+        }
 
         if (!should_deepen(search_data)) {
             search_data->current_depth += PLY;
             break;
         }
     }
+    return id_score;
+}
+
+/*
+ * Iterative deepening search of the root position. This is the external
+ * function that is called by the console interface. For each depth,
+ * |root_search| performs the actual search.
+ */
+void deepening_search(search_data_t* search_data, bool ponder)
+{
+    search_data->engine_status = ponder ? ENGINE_PONDERING : ENGINE_THINKING;
+    sync_transposition_table();
+    increment_transposition_age();
+    init_timer(&search_data->timer);
+    start_timer(&search_data->timer);
+
+    // Get a move out of the opening book if we can.
+    if (options.use_book &&
+            options.book_loaded &&
+            !search_data->infinite &&
+            !search_data->depth_limit &&
+            !search_data->node_limit &&
+            search_data->engine_status != ENGINE_PONDERING) {
+        move_t book_move = options.probe_book(&search_data->root_pos);
+        if (book_move) {
+            char move_str[7];
+            move_to_coord_str(book_move, move_str);
+            printf("info depth 0 nodes 0 score cp 0 pv %s\n", move_str);
+            printf("bestmove %s\n", move_str);
+            search_data->engine_status = ENGINE_IDLE;
+            return;
+        }
+    }
+
+    position_t* pos = &search_data->root_pos;
+    options.root_in_gtb = (pos->num_pieces[WHITE] + pos->num_pieces[BLACK] +
+            pos->num_pawns[WHITE] + pos->num_pawns[BLACK] <=
+            options.max_egtb_pieces && options.use_gtb);
+    options.use_gtb_dtm = false;
+
+    init_root_moves(search_data);
+    if (!search_data->depth_limit) {
+        search_data->depth_limit = MAX_SEARCH_PLY * PLY;
+    }
+    start_helpers(search_data);
+    int id_score = iterate_search(search_data);
+    stop_helpers();
     stop_timer(&search_data->timer);
     if (search_data->engine_status == ENGINE_PONDERING) uci_wait_for_command();
 
     search_data->current_depth -= PLY;
     search_data->best_score = id_score;
+    search_data->engine_status = ENGINE_IDLE;
+    if (search_data->quiet) return;
     if (options.verbosity > 1) {
         print_search_stats(search_data);
         printf("info string time target %d time limit %d elapsed time %d\n",
@@ -567,6 +683,7 @@ void deepening_search(search_data_t* search_data, bool ponder)
                 elapsed_time(&search_data->timer));
         print_transposition_stats();
         print_pawn_stats();
+        print_eval_cache_stats();
         print_pv_cache_stats();
         print_multipv(search_data);
     }
@@ -577,7 +694,57 @@ void deepening_search(search_data_t* search_data, bool ponder)
     printf("bestmove %s", best_move);
     if (search_data->pv[1]) printf(" ponder %s", ponder_move);
     printf("\n");
-    search_data->engine_status = ENGINE_IDLE;
+}
+
+/*
+ * Iterative deepening search run by helper threads. Helpers search the same
+ * root position as the main thread with a full window and no time control,
+ * and don't produce any output. Their results reach the main thread through
+ * the transposition table. Odd-numbered helpers start a ply deeper so that
+ * the threads don't all search the same depths in lockstep.
+ */
+void helper_deepening_search(search_data_t* data)
+{
+    assert(data->thread_id);
+    sync_pawn_table();
+    sync_eval_cache();
+    sync_material_table();
+    init_timer(&data->timer);
+    start_timer(&data->timer);
+    for (data->current_depth = (2 + (data->thread_id & 1))*PLY;
+            data->current_depth <= data->depth_limit;
+            data->current_depth += PLY) {
+        data->root_indecisiveness = 0;
+        if (root_search(data, mated_in(-1), mate_in(-1)) ==
+                SEARCH_ABORTED) break;
+    }
+    stop_timer(&data->timer);
+}
+
+/*
+ * Search the root position of |data| on the calling thread alone, until one
+ * of the depth, node, or time limits in |data| is reached. There's no
+ * output, no polling for input, and no help from other threads, so several
+ * independent searches of unrelated positions can run at once, one per
+ * thread. The best line found is left in |data->pv|.
+ */
+void independent_search(search_data_t* data)
+{
+    data->independent = true;
+    data->quiet = true;
+    data->engine_status = ENGINE_THINKING;
+    sync_pawn_table();
+    sync_eval_cache();
+    sync_material_table();
+    init_timer(&data->timer);
+    start_timer(&data->timer);
+    init_root_moves(data);
+    if (!data->depth_limit) data->depth_limit = MAX_SEARCH_PLY * PLY;
+    int id_score = iterate_search(data);
+    stop_timer(&data->timer);
+    data->current_depth -= PLY;
+    data->best_score = id_score;
+    data->engine_status = ENGINE_IDLE;
 }
 
 /*
@@ -591,11 +758,12 @@ static search_result_t root_search(search_data_t* search_data,
     int orig_alpha = alpha;
     search_data->best_score = alpha;
     position_t* pos = &search_data->root_pos;
-    transposition_entry_t* trans_entry = get_transposition(pos);
+    transposition_entry_t trans_buf;
+    transposition_entry_t* trans_entry = get_transposition(pos, &trans_buf);
     move_t hash_move = trans_entry ? trans_entry->move : NO_MOVE;
 
     move_selector_t selector;
-    init_move_selector(&selector, pos, ROOT_GEN,
+    init_move_selector(&selector, search_data, pos, ROOT_GEN,
             NULL, hash_move, search_data->current_depth, 0);
     search_data->current_move_index = 0;
     search_data->resolving_fail_high = false;
@@ -623,17 +791,17 @@ static search_result_t root_search(search_data_t* search_data,
         if (search_data->current_move_index < options.multi_pv) {
             // Use full window search.
             alpha = mated_in(-1);
-            score = -search(pos, search_data->search_stack,
+            score = -search(search_data, pos, search_data->search_stack,
                     1, -beta, -alpha, search_data->current_depth+ext-PLY);
         } else {
             const bool try_lmr = lmr_enabled && ext != 0 && !is_check(pos);
             int lmr_red = try_lmr ? lmr_reduction(&selector,
                     move, false) : 0;
             if (lmr_red) {
-                score = -search(pos, search_data->search_stack,
+                score = -search(search_data, pos, search_data->search_stack,
                         1, -alpha-1, -alpha, depth-lmr_red-PLY);
             } else {
-                score = -search(pos, search_data->search_stack,
+                score = -search(search_data, pos, search_data->search_stack,
                     1, -alpha-1, -alpha, search_data->current_depth+ext-PLY);
             }
             if (score > alpha) {
@@ -645,7 +813,7 @@ static search_result_t root_search(search_data_t* search_data,
                                 coord_move);
                     }
                     search_data->resolving_fail_high = true;
-                    score = -search(pos, search_data->search_stack,
+                    score = -search(search_data, pos, search_data->search_stack,
                             1, -beta, -alpha,
                             search_data->current_depth+ext-PLY);
                 }
@@ -666,7 +834,9 @@ static search_result_t root_search(search_data_t* search_data,
             }
             update_pv(search_data->pv, search_data->search_stack->pv, 0, move);
             check_line(pos, search_data->pv);
-            print_multipv(search_data);
+            if (!search_data->thread_id && !search_data->quiet) {
+                print_multipv(search_data);
+            }
         }
         search_data->resolving_fail_high = false;
     }
@@ -691,7 +861,8 @@ static search_result_t root_search(search_data_t* search_data,
 /*
  * Search an interior, non-quiescent node.
  */
-static int search(position_t* pos,
+static int search(search_data_t* data,
+        position_t* pos,
         search_node_t* search_node,
         int ply,
         int alpha,
@@ -699,8 +870,10 @@ static int search(position_t* pos,
         float depth)
 {
     search_node->pv[ply] = NO_MOVE;
-    if (root_data.engine_status == ENGINE_ABORTED) return 0;
-    if (depth < 0.5) return quiesce(pos, search_node, ply, alpha, beta, depth);
+    if (is_search_stopped(data)) return 0;
+    if (depth < 0.5) {
+        return quiesce(data, pos, search_node, ply, alpha, beta, depth);
+    }
 
     int orig_alpha = alpha;
     alpha = MAX(alpha, mated_in(ply));
@@ -710,24 +883,27 @@ static int search(position_t* pos,
     bool full_window = (beta-alpha > 1);
 
     // Get move from transposition table if possible.
-    transposition_entry_t* trans_entry = get_transposition(pos);
+    transposition_entry_t trans_buf;
+    transposition_entry_t* trans_entry = get_transposition(pos, &trans_buf);
     move_t hash_move = trans_entry ? trans_entry->move : NO_MOVE;
     bool mate_threat = trans_entry && trans_entry->flags & MATE_THREAT;
     if (!full_window && trans_entry &&
             is_trans_cutoff_allowed(trans_entry, depth, &alpha, &beta)) {
         search_node->pv[ply] = hash_move;
         search_node->pv[ply+1] = NO_MOVE;
-        root_data.stats.transposition_cutoffs[
-            depth_to_index(root_data.current_depth)]++;
+        data->stats.transposition_cutoffs[
+            depth_to_index(data->current_depth)]++;
         return MAX(alpha, trans_entry->score);
     }
 
     int score;
     // Check endgame bitbases/tablebases if appropriate
-    if (check_eg_database(pos, depth, ply, alpha, beta, &score)) return score;
+    if (check_eg_database(data, pos, depth, ply, alpha, beta, &score)) {
+        return score;
+    }
 
-    open_node(&root_data, ply);
-    if (full_window) root_data.pvnodes_searched++;
+    open_node(data, ply);
+    if (full_window) data->pvnodes_searched++;
     score = mated_in(-1);
     int lazy_score = simple_eval(pos);
     int depth_index = depth_to_index(depth);
@@ -745,18 +921,18 @@ static int search(position_t* pos,
         do_nullmove(pos, &undo);
         float null_r = 2.0 + ((depth + 2.0)/4.0) +
             CLAMP(0, 1.5, (lazy_score-beta)/100.0);
-        int null_score = -search(pos, search_node+1, ply+1,
+        int null_score = -search(data, pos, search_node+1, ply+1,
                 -beta, -beta+1, depth - null_r);
         undo_nullmove(pos, &undo);
         if (is_mate_score(null_score) && null_score < 0) mate_threat = true;
         if (null_score >= beta) {
             if (verification_enabled) {
                 float rdepth = depth - null_verification_reduction;
-                if (rdepth > 0) null_score = search(pos,
+                if (rdepth > 0) null_score = search(data, pos,
                         search_node, ply, alpha, beta, rdepth);
             }
-            root_data.stats.nullmove_cutoffs[
-                depth_to_index(root_data.current_depth)]++;
+            data->stats.nullmove_cutoffs[
+                depth_to_index(data->current_depth)]++;
             if (null_score >= beta) return beta;
         }
     } else if (razoring_enabled &&
@@ -767,9 +943,11 @@ static int search(position_t* pos,
             !is_mate_score(beta) &&
             lazy_score + razor_margin[depth_index] < beta) {
         // Razoring.
-        if (depth <= PLY) return quiesce(pos, search_node, ply, alpha, beta, 0);
+        if (depth <= PLY) {
+            return quiesce(data, pos, search_node, ply, alpha, beta, 0);
+        }
         int qbeta = beta - razor_qmargin[depth_index];
-        int qscore = quiesce(pos, search_node, ply, qbeta-1, qbeta, 0);
+        int qscore = quiesce(data, pos, search_node, ply, qbeta-1, qbeta, 0);
         if (qscore < qbeta) return qscore;
     }
 
@@ -780,21 +958,23 @@ static int search(position_t* pos,
                 depth - iid_pv_depth_reduction :
                 MIN(depth/2, depth - iid_non_pv_depth_reduction);
         assert(iid_depth > 0);
-        search(pos, search_node, ply, alpha, beta, iid_depth);
+        search(data, pos, search_node, ply, alpha, beta, iid_depth);
         hash_move = search_node->pv[ply];
         search_node->pv[ply] = NO_MOVE;
     }
 
     move_t searched_moves[256];
     move_selector_t selector;
-    init_move_selector(&selector, pos, full_window ? PV_GEN : NONPV_GEN,
+    init_move_selector(&selector, data,
+            pos, full_window ? PV_GEN : NONPV_GEN,
             search_node, hash_move, depth, ply);
     bool single_reply = has_single_reply(&selector);
     int num_legal_moves = 0, num_futile_moves = 0, num_searched_moves = 0;
+    bool did_split = false;
     for (move_t move = select_move(&selector); move != NO_MOVE;
             move = select_move(&selector)) {
         num_legal_moves = selector.moves_so_far;
-        int64_t nodes_before = root_data.nodes_searched;
+        int64_t nodes_before = data->nodes_searched;
 
         undo_info_t undo;
         do_move(pos, move, &undo);
@@ -805,7 +985,7 @@ static int search(position_t* pos,
         }
         if (num_legal_moves == 1) {
             // First move, use full window search.
-            score = -search(pos, search_node+1, ply+1,
+            score = -search(data, pos, search_node+1, ply+1,
                     -beta, -alpha, depth+ext-PLY);
         } else {
             // Futility pruning. Note: it would be nice to do extensions and
@@ -827,7 +1007,7 @@ static int search(position_t* pos,
                 // move order into the history count
                 // TODO: experiment with pruning inside pv
                 if (history_prune_enabled && depth <= 3.0 &&
-                        is_history_prune_allowed(&root_data.history,
+                        is_history_prune_allowed(&data->history,
                             move, depth)) {
                     num_futile_moves++;
                     undo_move(pos, move, &undo);
@@ -854,49 +1034,34 @@ static int search(position_t* pos,
                 depth > lmr_depth_limit;
             float lmr_red = 0;
             if (try_lmr) lmr_red = lmr_reduction(&selector, move, full_window);
-            if (lmr_red) score = -search(pos, search_node+1, ply+1,
+            if (lmr_red) score = -search(data, pos, search_node+1, ply+1,
                     -alpha-1, -alpha, depth-lmr_red-PLY);
             else score = alpha+1;
             if (score > alpha) {
-                score = -search(pos, search_node+1, ply+1,
+                score = -search(data, pos, search_node+1, ply+1,
                         -alpha-1, -alpha, depth+ext-PLY);
-                if (score > alpha) score = -search(pos, search_node+1, ply+1,
-                        -beta, -alpha, depth+ext-PLY);
+                if (score > alpha) score = -search(data, pos,
+                        search_node+1, ply+1, -beta, -alpha, depth+ext-PLY);
             }
         }
         searched_moves[num_searched_moves++] = move;
         undo_move(pos, move, &undo);
+        if (is_search_stopped(data)) return 0;
         if (full_window) add_pv_move(&selector, move,
-                root_data.nodes_searched - nodes_before);
+                data->nodes_searched - nodes_before);
         if (score > alpha) {
             alpha = score;
             update_pv(search_node->pv, (search_node+1)->pv, ply, move);
             check_line(pos, search_node->pv+ply);
             if (score >= beta) {
-                if (!get_move_capture(move) &&
-                        !get_move_promote(move)) {
-                    record_success(&root_data.history, move, depth);
-                    for (int i=0; i<num_searched_moves-1; ++i) {
-                        move_t m = searched_moves[i];
-                        assert(m != move);
-                        if (!get_move_capture(m) && !get_move_promote(m)) {
-                            record_failure(&root_data.history, m, depth);
-                        }
-                    }
-                    if (move != search_node->killers[0]) {
-                        search_node->killers[1] = search_node->killers[0];
-                        search_node->killers[0] = move;
-                    }
-                }
-                if (is_mate_score(score) && score > 0) {
-                    search_node->mate_killer = move;
-                }
+                record_cutoff(data, search_node, move, score, depth,
+                        searched_moves, num_searched_moves);
                 put_transposition(pos, move, depth, beta,
                         SCORE_LOWERBOUND, mate_threat);
-                root_data.stats.move_selection[
+                data->stats.move_selection[
                     MIN(num_legal_moves-1, HIST_BUCKETS)]++;
                 if (full_window) {
-                    root_data.stats.pv_move_selection[
+                    data->stats.pv_move_selection[
                         MIN(num_legal_moves-1, HIST_BUCKETS)]++;
                     while ((move = select_move(&selector))) {
                         add_pv_move(&selector, move, 0);
@@ -907,8 +1072,34 @@ static int search(position_t* pos,
                 return beta;
             }
         }
+
+        // Young Brothers Wait: now that at least one move has been searched,
+        // let any idle threads help with the rest.
+        if (depth >= options.split_depth && can_split(data)) {
+            move_t cutoff_move = NO_MOVE;
+            did_split = split_search(data, pos, &selector, search_node,
+                    ply, depth, &alpha, beta, lazy_score, full_window,
+                    mate_threat, searched_moves, &num_searched_moves,
+                    &cutoff_move);
+            if (!did_split) continue;
+            if (is_search_stopped(data)) return 0;
+            num_legal_moves = selector.moves_so_far;
+            if (cutoff_move) {
+                record_cutoff(data, search_node, cutoff_move, alpha, depth,
+                        searched_moves, num_searched_moves);
+                put_transposition(pos, cutoff_move, depth, beta,
+                        SCORE_LOWERBOUND, mate_threat);
+                data->stats.move_selection[
+                    MIN(num_legal_moves-1, HIST_BUCKETS)]++;
+                if (full_window) data->stats.pv_move_selection[
+                    MIN(num_legal_moves-1, HIST_BUCKETS)]++;
+                search_node->pv[ply] = NO_MOVE;
+                return beta;
+            }
+            break;
+        }
     }
-    if (full_window) commit_pv_moves(&selector);
+    if (full_window && !did_split) commit_pv_moves(&selector);
     if (!num_legal_moves) {
         // No legal moves, this is either stalemate or checkmate.
         search_node->pv[ply] = NO_MOVE;
@@ -916,8 +1107,8 @@ static int search(position_t* pos,
         return DRAW_VALUE;
     }
 
-    root_data.stats.move_selection[MIN(num_legal_moves-1, HIST_BUCKETS)]++;
-    if (full_window) root_data.stats.pv_move_selection[
+    data->stats.move_selection[MIN(num_legal_moves-1, HIST_BUCKETS)]++;
+    if (full_window) data->stats.pv_move_selection[
         MIN(num_legal_moves-1, HIST_BUCKETS)]++;
     if (alpha == orig_alpha) {
         put_transposition(pos, NO_MOVE, depth, alpha,
@@ -929,25 +1120,198 @@ static int search(position_t* pos,
     return alpha;
 }
 
+/*
+ * Try to turn the current node into a split point and search its remaining
+ * moves in parallel. On success, |alpha|, |searched_moves| and
+ * |num_searched_moves| are updated with the combined results of all threads,
+ * and |cutoff_move| is set if the node failed high. This is kept out of line
+ * so that the split point doesn't take up space in every |search| frame.
+ */
+static NOINLINE bool split_search(search_data_t* data,
+        position_t* pos,
+        move_selector_t* sel,
+        search_node_t* search_node,
+        int ply,
+        float depth,
+        int* alpha,
+        int beta,
+        int lazy_score,
+        bool full_window,
+        bool mate_threat,
+        move_t* searched_moves,
+        int* num_searched_moves,
+        move_t* cutoff_move)
+{
+    split_point_t sp;
+    copy_position(&sp.pos, pos);
+    sp.selector = sel;
+    sp.search_node = search_node;
+    sp.ply = ply;
+    sp.depth = depth;
+    sp.alpha = *alpha;
+    sp.beta = beta;
+    sp.lazy_score = lazy_score;
+    sp.full_window = full_window;
+    sp.mate_threat = mate_threat;
+    sp.cutoff_move = NO_MOVE;
+    sp.num_searched_moves = *num_searched_moves;
+    memcpy(sp.searched_moves, searched_moves,
+            *num_searched_moves * sizeof(move_t));
+
+    // The selector has to keep working while we're making moves in |pos|,
+    // so point it at the split point's copy of the position.
+    sel->pos = &sp.pos;
+    if (!split(data, &sp)) {
+        sel->pos = pos;
+        return false;
+    }
+    search_split_point(data, &sp);
+    wait_for_slaves(data, &sp);
+    sel->pos = pos;
+
+    *alpha = sp.alpha;
+    *num_searched_moves = sp.num_searched_moves;
+    memcpy(searched_moves, sp.searched_moves,
+            sp.num_searched_moves * sizeof(move_t));
+    if (sp.cutoff_move) {
+        searched_moves[(*num_searched_moves)++] = sp.cutoff_move;
+        *cutoff_move = sp.cutoff_move;
+    }
+    return true;
+}
+
+/*
+ * Search the remaining moves at a split point. This is run concurrently by
+ * the split point's master and all of its slaves, and mirrors the move loop
+ * in |search|. Moves are handed out by the master's move selector under the
+ * split point's lock, and each thread searches them in its own copy of the
+ * position.
+ */
+void search_split_point(search_data_t* data, split_point_t* sp)
+{
+    position_t pos_storage;
+    position_t* pos = &pos_storage;
+    hash_history_t hash_history;
+    // Other threads may be making and unmaking moves in |sp->pos| inside
+    // the move selector, so only copy it while we hold the lock.
+    lock_grab(sp->lock);
+    copy_position(pos, &sp->pos);
+    attach_hash_history(pos, &hash_history);
+    lock_release(sp->lock);
+    split_point_t* parent_split = data->split_point;
+    data->split_point = sp;
+
+    const int ply = sp->ply;
+    const float depth = sp->depth;
+    const int depth_index = depth_to_index(depth);
+    const bool full_window = sp->full_window;
+    const bool mate_threat = sp->mate_threat;
+    search_node_t* search_node = &data->search_stack[ply-1];
+    if (search_node != sp->search_node) {
+        search_node->killers[0] = sp->search_node->killers[0];
+        search_node->killers[1] = sp->search_node->killers[1];
+        search_node->mate_killer = sp->search_node->mate_killer;
+    }
+
+    while (true) {
+        // Everything that depends on the selector's state has to be
+        // computed while we hold the lock.
+        lock_grab(sp->lock);
+        move_t move = sp->stop ? NO_MOVE : select_move(sp->selector);
+        if (!move) {
+            lock_release(sp->lock);
+            break;
+        }
+        const int num_legal_moves = sp->selector->moves_so_far;
+        const bool prune_allowed = should_try_prune(sp->selector, move);
+        float lmr_red = lmr_reduction(sp->selector, move, full_window);
+        int alpha = sp->alpha;
+        lock_release(sp->lock);
+
+        undo_info_t undo;
+        do_move(pos, move, &undo);
+        float ext = extend(pos, move, false, full_window);
+        const bool prune_futile = futility_enabled &&
+            !full_window &&
+            !ext &&
+            !mate_threat &&
+            depth <= futility_depth_limit &&
+            !is_check(pos) &&
+            num_legal_moves >= depth_index + 2 &&
+            prune_allowed;
+        if (prune_futile) {
+            if (history_prune_enabled && depth <= 3.0 &&
+                    is_history_prune_allowed(&data->history, move, depth)) {
+                undo_move(pos, move, &undo);
+                continue;
+            }
+            if (value_prune_enabled &&
+                    sp->lazy_score +
+                    material_value(get_move_capture(move)) +
+                    85 + 15*depth + 2*depth*depth <
+                    sp->beta + 2*num_legal_moves) {
+                undo_move(pos, move, &undo);
+                continue;
+            }
+        }
+        const bool try_lmr = lmr_enabled &&
+            !ext &&
+            !mate_threat &&
+            depth > lmr_depth_limit;
+        if (!try_lmr) lmr_red = 0;
+        int score;
+        if (lmr_red) score = -search(data, pos, search_node+1, ply+1,
+                -alpha-1, -alpha, depth-lmr_red-PLY);
+        else score = alpha+1;
+        if (score > alpha) {
+            score = -search(data, pos, search_node+1, ply+1,
+                    -alpha-1, -alpha, depth+ext-PLY);
+            if (score > alpha) score = -search(data, pos,
+                    search_node+1, ply+1, -sp->beta, -alpha, depth+ext-PLY);
+        }
+        undo_move(pos, move, &undo);
+        if (is_search_stopped(data)) break;
+
+        lock_grab(sp->lock);
+        if (!sp->stop) {
+            if (score > sp->alpha) {
+                sp->alpha = score;
+                update_pv(sp->search_node->pv, (search_node+1)->pv, ply, move);
+                check_line(pos, sp->search_node->pv+ply);
+                if (score >= sp->beta) {
+                    sp->cutoff_move = move;
+                    sp->stop = true;
+                }
+            }
+            if (!sp->stop) {
+                sp->searched_moves[sp->num_searched_moves++] = move;
+            }
+        }
+        lock_release(sp->lock);
+    }
+    data->split_point = parent_split;
+}
+
 /*
  * Search a position until it becomes "quiet". This is called at the leaves
  * of |search| to avoid using the static evaluator on positions that have
  * easy tactics on the board.
  */
-static int quiesce(position_t* pos,
+static int quiesce(search_data_t* data,
+        position_t* pos,
         search_node_t* search_node,
         int ply,
         int alpha,
         int beta,
         float depth)
 {
-    if (root_data.engine_status == ENGINE_ABORTED) return 0;
-    if (root_data.current_root_move &&
-            ply > root_data.current_root_move->max_ply) {
-        root_data.current_root_move->max_ply = ply;
+    if (is_search_stopped(data)) return 0;
+    if (data->current_root_move &&
+            ply > data->current_root_move->max_ply) {
+        data->current_root_move->max_ply = ply;
     }
     search_node->pv[ply] = NO_MOVE;
-    open_qnode(&root_data, ply);
+    open_qnode(data, ply);
 
     alpha = MAX(alpha, mated_in(ply));
     beta = MIN(beta, mate_in(ply));
@@ -957,14 +1321,15 @@ static int quiesce(position_t* pos,
 
     // Get move from transposition table if possible.
     int orig_alpha = alpha;
-    transposition_entry_t* trans_entry = get_transposition(pos);
+    transposition_entry_t trans_buf;
+    transposition_entry_t* trans_entry = get_transposition(pos, &trans_buf);
     move_t hash_move = trans_entry ? trans_entry->move : NO_MOVE;
     if (trans_entry && 
             is_trans_cutoff_allowed(trans_entry, depth, &alpha, &beta)) {
         search_node->pv[ply] = hash_move;
         search_node->pv[ply+1] = NO_MOVE;
-        root_data.stats.transposition_cutoffs[
-            depth_to_index(root_data.current_depth)]++;
+        data->stats.transposition_cutoffs[
+            depth_to_index(data->current_depth)]++;
         return MAX(alpha, trans_entry->score);
     }
 
@@ -992,7 +1357,7 @@ static int quiesce(position_t* pos,
     move_selector_t selector;
     generation_t gen_type = depth >= -0.5 && eval + 150 >= alpha ?
         Q_CHECK_GEN : Q_GEN;
-    init_move_selector(&selector, pos, gen_type,
+    init_move_selector(&selector, data, pos, gen_type,
             search_node, hash_move, depth, ply);
     for (move_t move = select_move(&selector); move != NO_MOVE;
             move = select_move(&selector), ++num_qmoves) {
@@ -1006,7 +1371,8 @@ static int quiesce(position_t* pos,
         if (move != hash_move && static_exchange_sign(pos, move) < 0) continue;
         undo_info_t undo;
         do_move(pos, move, &undo);
-        int score = -quiesce(pos, search_node+1, ply+1, -beta, -alpha, depth-PLY);
+        int score = -quiesce(data, pos, search_node+1,
+                ply+1, -beta, -alpha, depth-PLY);
         undo_move(pos, move, &undo);
         if (score > alpha) {
             alpha = score;
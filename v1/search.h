@@ -49,11 +49,14 @@ typedef struct {
     bool chess960;
     bool arena_castle;
     bool ponder;
+    int smp_mode;
+    int split_depth;
 } options_t;
 
 extern options_t options;
 
 #define HIST_BUCKETS    15
+#define NUM_GENERATORS  6   // the number of generation_t values
 
 typedef struct {
     int transposition_cutoffs[MAX_SEARCH_PLY + 1];
@@ -65,6 +68,15 @@ typedef struct {
     int root_fail_highs;
     int root_fail_lows;
     int egbb_hits;
+    int splits;
+    uint64_t staged_nodes;
+    uint64_t quiet_generations;
+    uint64_t moves_generated;
+    uint64_t selector_nodes[NUM_GENERATORS];
+    uint64_t moves_selected[NUM_GENERATORS];
+    uint64_t moves_consumed[NUM_GENERATORS][HIST_BUCKETS + 1];
+    uint64_t move_picks[NUM_GENERATORS];
+    uint64_t move_sorts[NUM_GENERATORS];
 } search_stats_t;
 
 typedef struct {
@@ -108,7 +120,17 @@ typedef struct {
     int current_move_index;
     bool resolving_fail_high;
     move_t obvious_move;
-    engine_status_t engine_status;
+    volatile engine_status_t engine_status;
+
+    // parallel search state
+    int thread_id;
+    bool independent;   // searching a position of its own, see
+                        // independent_search
+    bool quiet;         // no uci output
+    struct split_point_s* split_point;
+    struct split_point_s* volatile split_work;
+    volatile bool idle;
+    int active_splits;
 
     // when should we stop?
     milli_timer_t timer;
@@ -119,6 +141,10 @@ typedef struct {
     int time_bonus;
     int mate_search; // TODO: implement me
     bool infinite;
+
+    // Repetition history for root_pos and the positions searched from it.
+    // This has to stay last; init_search_data leaves it alone.
+    hash_history_t hash_history;
 } search_data_t;
 
 extern search_data_t root_data;
@@ -134,7 +160,8 @@ extern search_data_t root_data;
 #define mate_in(ply)                (MATE_VALUE-(ply))
 #define mated_in(ply)               (-MATE_VALUE+(ply))
 #define should_output(s)    \
-    (elapsed_time(&((s)->timer)) > options.output_delay)
+    ((s)->thread_id == 0 && !(s)->quiet && \
+     elapsed_time(&((s)->timer)) > options.output_delay)
 
 
 #ifdef __cplusplus
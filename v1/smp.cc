@@ -0,0 +1,393 @@
+
+#include "daydreamer.h"
+#include <string.h>
+
+#ifndef WINDOWS_THREADS
+#include <sched.h>
+#endif
+
+/*
+ * Shared-memory parallel search. Two modes are supported. In shared hash
+ * mode, helper threads run their own iterative deepening searches of the
+ * root position alongside the main thread, communicating only through the
+ * shared transposition table. In split point mode (Young Brothers Wait),
+ * helpers sit idle until a thread that has finished searching the first move
+ * at some node offers them the remaining moves. In both modes the main thread
+ * owns all time management and output.
+ */
+
+#define THREAD_STACK_BYTES  (8*1024*1024)
+
+typedef struct {
+    search_data_t data;
+    volatile bool searching;
+    volatile bool quit;
+    thread_task_t volatile task;
+    void* task_arg;
+#ifdef WINDOWS_THREADS
+    HANDLE handle;
+#else
+    pthread_t handle;
+#endif
+} helper_thread_t;
+
+static helper_thread_t* helpers[MAX_THREADS];
+static search_data_t* thread_data[MAX_THREADS];
+static int num_threads = 1;
+static lock_t smp_lock;
+static volatile bool split_search_active = false;
+static bool split_mode = false;
+
+static void do_split_work(search_data_t* data);
+
+/*
+ * Give up the processor briefly while spinning.
+ */
+static void yield_thread(void)
+{
+#ifdef WINDOWS_THREADS
+    Sleep(0);
+#else
+    sched_yield();
+#endif
+}
+
+/*
+ * The idle loop for helper threads. Wait for the main thread to hand us a
+ * search, a split point, or some other task, run it, and go back to
+ * waiting. While a split point search is underway we just yield instead of
+ * sleeping, so that new split points get picked up quickly.
+ */
+#ifdef WINDOWS_THREADS
+static DWORD WINAPI helper_loop(LPVOID payload)
+#else
+static void* helper_loop(void* payload)
+#endif
+{
+    helper_thread_t* helper = (helper_thread_t*)payload;
+    set_transposition_thread(helper->data.thread_id);
+    set_instrument_thread(helper->data.thread_id);
+    while (!helper->quit) {
+        if (helper->searching) {
+            helper_deepening_search(&helper->data);
+            memory_barrier();
+            helper->searching = false;
+        } else if (helper->data.split_work) {
+            do_split_work(&helper->data);
+        } else if (helper->task) {
+            helper->task(helper->data.thread_id, num_threads,
+                    helper->task_arg);
+            memory_barrier();
+            helper->task = NULL;
+        } else if (split_search_active) {
+            yield_thread();
+        } else {
+#ifdef WINDOWS_THREADS
+            Sleep(1);
+#else
+            usleep(1000);
+#endif
+        }
+    }
+
+    // Our thread-local tables die with us, so free them on the way out.
+    release_pawn_table();
+    release_eval_cache();
+    release_material_table();
+    return 0;
+}
+
+/*
+ * Stop and destroy all helper threads.
+ */
+static void destroy_helpers(void)
+{
+    stop_helpers();
+    for (int i=1; i<num_threads; ++i) {
+        helpers[i]->quit = true;
+#ifdef WINDOWS_THREADS
+        WaitForSingleObject(helpers[i]->handle, INFINITE);
+        CloseHandle(helpers[i]->handle);
+#else
+        pthread_join(helpers[i]->handle, NULL);
+#endif
+        free(helpers[i]);
+        helpers[i] = NULL;
+        thread_data[i] = NULL;
+    }
+    num_threads = 1;
+}
+
+/*
+ * Set the number of threads used for searching, including the main thread.
+ * Any existing helpers are torn down and replaced.
+ */
+void init_threads(int threads)
+{
+    static bool initialized = false;
+    if (!initialized) {
+        lock_init(smp_lock);
+        initialized = true;
+    }
+    destroy_helpers();
+    thread_data[0] = &root_data;
+    threads = CLAMP(threads, 1, MAX_THREADS);
+    for (num_threads=1; num_threads<threads; ++num_threads) {
+        helper_thread_t* helper =
+            (helper_thread_t*)malloc(sizeof(helper_thread_t));
+        if (!helper) break;
+        memset(helper, 0, sizeof(helper_thread_t));
+        helper->data.thread_id = num_threads;
+#ifdef WINDOWS_THREADS
+        helper->handle = CreateThread(NULL, THREAD_STACK_BYTES,
+                helper_loop, helper, 0, NULL);
+        if (!helper->handle) {
+#else
+        pthread_attr_t attr;
+        pthread_attr_init(&attr);
+        pthread_attr_setstacksize(&attr, THREAD_STACK_BYTES);
+        int err = pthread_create(&helper->handle, &attr, helper_loop, helper);
+        pthread_attr_destroy(&attr);
+        if (err) {
+#endif
+            printf("info string helper thread creation failed\n");
+            free(helper);
+            break;
+        }
+        helpers[num_threads] = helper;
+        thread_data[num_threads] = &helper->data;
+    }
+}
+
+/*
+ * How many threads (including the main thread) are available for search?
+ */
+int get_num_threads(void)
+{
+    return num_threads;
+}
+
+/*
+ * Run |task| on every thread at once, with the calling thread acting as
+ * thread 0, and wait until they're all finished. Each thread is given its
+ * id and the total number of threads so that it can pick out its own share
+ * of the work. Must not be called while a search is running.
+ */
+void run_on_all_threads(thread_task_t task, void* arg)
+{
+    for (int i=1; i<num_threads; ++i) {
+        assert(!helpers[i]->searching && !helpers[i]->task);
+        helpers[i]->task_arg = arg;
+        memory_barrier();
+        helpers[i]->task = task;
+    }
+    task(0, num_threads, arg);
+    for (int i=1; i<num_threads; ++i) {
+#ifdef WINDOWS_THREADS
+        while (helpers[i]->task) Sleep(1);
+#else
+        while (helpers[i]->task) usleep(100);
+#endif
+    }
+}
+
+/*
+ * Get the search data belonging to the thread with the given id.
+ */
+search_data_t* get_thread_data(int thread_id)
+{
+    assert(thread_id >= 0 && thread_id < num_threads);
+    return thread_data[thread_id];
+}
+
+/*
+ * Get the helpers ready to search the root position in |data|. In shared
+ * hash mode they start searching immediately; in split point mode they
+ * wait for work.
+ */
+void start_helpers(search_data_t* data)
+{
+    split_mode = options.smp_mode == SMP_SPLIT_POINT;
+    for (int i=1; i<num_threads; ++i) {
+        helper_thread_t* helper = helpers[i];
+        assert(!helper->searching && !helper->data.split_work);
+        copy_position(&helper->data.root_pos, &data->root_pos);
+        init_search_data(&helper->data);
+        memcpy(helper->data.root_moves, data->root_moves,
+                sizeof(data->root_moves));
+        helper->data.thread_id = i;
+        helper->data.depth_limit = data->depth_limit;
+        helper->data.engine_status = ENGINE_THINKING;
+        helper->data.idle = split_mode;
+        memory_barrier();
+        if (!split_mode) helper->searching = true;
+    }
+    split_search_active = split_mode && num_threads > 1;
+}
+
+/*
+ * Is this helper still doing anything with the current search?
+ */
+static bool is_helper_busy(helper_thread_t* helper)
+{
+    return helper->searching || helper->data.split_work ||
+        (split_mode && !helper->data.idle);
+}
+
+/*
+ * Abort all helper searches and wait until every helper is idle.
+ */
+void stop_helpers(void)
+{
+    split_search_active = false;
+    for (int i=1; i<num_threads; ++i) {
+        helpers[i]->data.engine_status = ENGINE_ABORTED;
+    }
+    for (int i=1; i<num_threads; ++i) {
+#ifdef WINDOWS_THREADS
+        while (is_helper_busy(helpers[i])) Sleep(1);
+#else
+        while (is_helper_busy(helpers[i])) usleep(100);
+#endif
+        helpers[i]->data.idle = false;
+    }
+    split_mode = false;
+}
+
+/*
+ * Total nodes searched by the main thread and all helpers during the
+ * current search.
+ */
+uint64_t total_nodes_searched(const search_data_t* data)
+{
+    uint64_t nodes = data->nodes_searched;
+    for (int i=1; i<num_threads; ++i) nodes += helpers[i]->data.nodes_searched;
+    return nodes;
+}
+
+/*
+ * Can the thread with id |thread_id| help out at a split point created by
+ * |master|? Threads that are waiting for their own split point to finish
+ * only help the threads that are working for them.
+ */
+static bool is_thread_available(int thread_id, int master)
+{
+    search_data_t* data = thread_data[thread_id];
+    if (!data->idle || data->split_work) return false;
+    if (!data->split_point) return true;
+    return (data->split_point->slaves & (1ull << master)) != 0;
+}
+
+/*
+ * Is it worth trying to create a split point? This is a quick unlocked test,
+ * |split| does the real checking.
+ */
+bool can_split(const search_data_t* data)
+{
+    if (!split_search_active ||
+            data->active_splits >= MAX_ACTIVE_SPLITS) return false;
+    for (int i=0; i<num_threads; ++i) {
+        if (i != data->thread_id &&
+                is_thread_available(i, data->thread_id)) return true;
+    }
+    return false;
+}
+
+/*
+ * Turn the node described by |sp| into a split point, and assign all
+ * available threads to it. The caller is responsible for filling in the
+ * search state in |sp|. Returns false if no threads could be found, in which
+ * case the caller just keeps searching on its own.
+ */
+bool split(search_data_t* data, split_point_t* sp)
+{
+    lock_grab(smp_lock);
+    uint64_t slaves = 0;
+    for (int i=0; i<num_threads; ++i) {
+        if (i != data->thread_id &&
+                is_thread_available(i, data->thread_id)) {
+            slaves |= 1ull << i;
+        }
+    }
+    if (!slaves || data->active_splits >= MAX_ACTIVE_SPLITS) {
+        lock_release(smp_lock);
+        return false;
+    }
+    sp->parent = data->split_point;
+    sp->master = data;
+    sp->slaves = slaves;
+    sp->stop = false;
+    lock_init(sp->lock);
+    data->split_point = sp;
+    data->active_splits++;
+    data->stats.splits++;
+    memory_barrier();
+    for (int i=0; i<num_threads; ++i) {
+        if (!(slaves & (1ull << i))) continue;
+        thread_data[i]->idle = false;
+        thread_data[i]->split_work = sp;
+    }
+    lock_release(smp_lock);
+    return true;
+}
+
+/*
+ * Search the split point assigned to |data|, then report back to the split
+ * point's master and go idle. The assignment is cleared before we start so
+ * that any split points we create in the meantime don't mistake it for new
+ * work.
+ */
+static void do_split_work(search_data_t* data)
+{
+    lock_grab(smp_lock);
+    split_point_t* sp = data->split_work;
+    data->split_work = NULL;
+    lock_release(smp_lock);
+    sync_pawn_table();
+    sync_eval_cache();
+    sync_material_table();
+    search_split_point(data, sp);
+    lock_grab(sp->lock);
+    sp->slaves &= ~(1ull << data->thread_id);
+    lock_release(sp->lock);
+    lock_grab(smp_lock);
+    data->idle = true;
+    lock_release(smp_lock);
+}
+
+/*
+ * Called by the master of |sp| once it runs out of moves to search. Wait for
+ * all slaves to finish, helping them out with their own split points in the
+ * meantime.
+ */
+void wait_for_slaves(search_data_t* data, split_point_t* sp)
+{
+    assert(sp->master == data && data->split_point == sp);
+    lock_grab(smp_lock);
+    data->idle = true;
+    lock_release(smp_lock);
+    while (true) {
+        if (data->split_work) {
+            do_split_work(data);
+            continue;
+        }
+        if (sp->slaves) {
+            yield_thread();
+            continue;
+        }
+        lock_grab(smp_lock);
+        if (!data->split_work && !sp->slaves) {
+            data->idle = false;
+            lock_release(smp_lock);
+            break;
+        }
+        lock_release(smp_lock);
+    }
+
+    // Make sure the last slave is done with the lock before we destroy it.
+    lock_grab(sp->lock);
+    lock_release(sp->lock);
+    lock_destroy(sp->lock);
+    data->split_point = sp->parent;
+    data->active_splits--;
+}
@@ -0,0 +1,67 @@
+
+#ifndef SMP_H
+#define SMP_H
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#ifndef WINDOWS_THREADS
+#include <pthread.h>
+#endif
+
+#define MAX_THREADS         64
+#define MAX_ACTIVE_SPLITS   8
+
+#ifdef WINDOWS_THREADS
+typedef CRITICAL_SECTION lock_t;
+#define lock_init(x)        InitializeCriticalSection(&(x))
+#define lock_grab(x)        EnterCriticalSection(&(x))
+#define lock_release(x)     LeaveCriticalSection(&(x))
+#define lock_destroy(x)     DeleteCriticalSection(&(x))
+#else
+typedef pthread_mutex_t lock_t;
+#define lock_init(x)        pthread_mutex_init(&(x), NULL)
+#define lock_grab(x)        pthread_mutex_lock(&(x))
+#define lock_release(x)     pthread_mutex_unlock(&(x))
+#define lock_destroy(x)     pthread_mutex_destroy(&(x))
+#endif
+
+typedef enum {
+    SMP_SHARED_HASH, SMP_SPLIT_POINT
+} smp_mode_t;
+
+// A piece of work that can be divided up among all the search threads.
+typedef void (*thread_task_t)(int thread_id, int num_threads, void* arg);
+
+/*
+ * A node in the search tree whose remaining moves are being searched by more
+ * than one thread. The node's move selector belongs to the thread that
+ * created the split point, and may only be used while holding |lock|.
+ */
+typedef struct split_point_s {
+    struct split_point_s* parent;
+    search_data_t* master;
+    volatile uint64_t slaves;
+    lock_t lock;
+
+    position_t pos;
+    move_selector_t* selector;
+    search_node_t* search_node;
+    int ply;
+    float depth;
+    int beta;
+    int lazy_score;
+    bool full_window;
+    bool mate_threat;
+
+    volatile int alpha;
+    volatile bool stop;
+    move_t cutoff_move;
+    move_t searched_moves[256];
+    int num_searched_moves;
+} split_point_t;
+
+#ifdef __cplusplus
+} // extern "C"
+#endif
+#endif // SMP_H
@@ -1,129 +1,99 @@
 
 #include "daydreamer.h"
+#include <string.h>
+
+// Results are cached by (hash, move), since the same capture usually gets
+// evaluated once when the move list is ordered and again when quiescence
+// search decides whether to prune it. Entries pack the upper 48 bits of the
+// key together with the 16-bit score, as in the eval cache. The table is
+// small and each thread has its own, so it never needs clearing: a changed
+// position just means a different key.
+typedef uint64_t see_cache_entry_t;
+#define SEE_CACHE_BUCKETS       1024
+#define see_cache_key_mask      (~(uint64_t)0xffff)
+#define see_cache_key(hash, move) \
+    ((hash) ^ ((uint64_t)(move) * 0x9e3779b97f4a7c15ull))
+
+static THREAD_LOCAL see_cache_entry_t see_cache[SEE_CACHE_BUCKETS];
+
+static const piece_type_t exchange_order[] = {
+    PAWN, KNIGHT, BISHOP, ROOK, QUEEN, KING
+};
 
 /*
- * Count all attackers and defenders of a square to determine whether or not
- * a capture is advantageous. Captures with a positive static eval are
- * favorable. Note: this implementation does not account for pinned pieces.
+ * Play out all captures on the target square of |move| in order of
+ * increasing attacker value, alternating colors, and work out what the
+ * capture is worth if both sides stop capturing when it suits them. Sliders
+ * that are uncovered as pieces leave the square's lines join in, and pieces
+ * pinned to their king away from the square stay out of the exchange for as
+ * long as the pinning piece is still on the board.
  */
-int static_exchange_eval(const position_t* pos, move_t move)
+static int compute_static_exchange_eval(const position_t* pos, move_t move)
 {
-    square_t attacker_sq = get_move_from(move);
-    square_t attacked_sq = get_move_to(move);
+    const square_t from = get_move_from(move);
+    const square_t to = get_move_to(move);
+    const int to_index = square_to_index(to);
     piece_t attacker = get_move_piece(move);
-    piece_t captured = get_move_capture(move);
-    square_t attacker_sqs[2][16];
-    int num_attackers[2] = { 0, 0 };
-    int initial_attacker[2] = { 0, 0 };
-    int index;
+    const bitboard_t* bb = pos->piece_bb;
+    const bitboard_t diagonals = bb[WB] | bb[BB] | bb[WQ] | bb[BQ];
+    const bitboard_t straights = bb[WR] | bb[BR] | bb[WQ] | bb[BQ];
 
-    // Find all the pieces that could be attacking.
-    // Pawns are handled separately, because there are potentially a lot of
-    // them and only a few squares they could attack from.
-    if (pos->board[attacked_sq + NW] == BP && attacked_sq + NW != attacker_sq) {
-        index = num_attackers[BLACK]++;
-        attacker_sqs[BLACK][index] = attacked_sq + NW;
-    }
-    if (pos->board[attacked_sq + NE] == BP && attacked_sq + NE != attacker_sq) {
-        index = num_attackers[BLACK]++;
-        attacker_sqs[BLACK][index] = attacked_sq + NE;
-    }
-    if (pos->board[attacked_sq + SW] == WP && attacked_sq + SW != attacker_sq) {
-        index = num_attackers[WHITE]++;
-        attacker_sqs[WHITE][index] = attacked_sq + SW;
+    bitboard_t occupied =
+        (pos->occupied_bb[WHITE] | pos->occupied_bb[BLACK]) ^ sq_bit(from);
+    if (is_move_enpassant(move)) {
+        occupied ^= sq_bit(to - pawn_push[piece_color(attacker)]);
     }
-    if (pos->board[attacked_sq + SE] == WP && attacked_sq + SE != attacker_sq) {
-        index = num_attackers[WHITE]++;
-        attacker_sqs[WHITE][index] = attacked_sq + SE;
-    }
-    
+    bitboard_t attackers = attackers_to(pos, to, occupied) & occupied;
+
+    // Only look for pins if the side has a piece that can take part. Pinned
+    // pieces can still capture along the line of the pin.
+    bitboard_t pinned[2] = { EMPTY_BB, EMPTY_BB };
+    bitboard_t pinners[2] = { EMPTY_BB, EMPTY_BB };
     for (color_t side=WHITE; side<=BLACK; ++side) {
-        square_t from, att_sq;
-        piece_t piece;
-        square_t att_dir;
-        for (int i=0; pos->pieces[side][i] != INVALID_SQUARE; ++i) {
-            from = pos->pieces[side][i];
-            piece = pos->board[from];
-            if (from == attacker_sq) continue;
-            if (!possible_attack(from, attacked_sq, piece)) continue;
-            piece_type_t type = piece_type(piece);
-            switch (type) {
-                case KING:
-                case KNIGHT:
-                    attacker_sqs[side][num_attackers[side]++] = from;
-                    break;
-                case BISHOP:
-                case ROOK:
-                case QUEEN:
-                    att_dir = (square_t)direction(from, attacked_sq);
-                    for (att_sq = from + att_dir; att_sq != attacked_sq &&
-                            pos->board[att_sq] == EMPTY; att_sq += att_dir) {}
-                    if (att_sq == attacked_sq) {
-                        attacker_sqs[side][num_attackers[side]++] = from;
-                    }
-                    break;
-                default: assert(false);
-            }
+        if (attackers & pos->occupied_bb[side]) {
+            const int king = square_to_index(pos->pieces[side][0]);
+            pinned[side] = pinned_pieces(pos, side, &pinners[side]) &
+                ~line_mask[king][to_index];
         }
     }
+    // Whatever stood on the target square is gone after the first capture.
+    const bitboard_t survivors = ~sq_bit(to);
 
-    // At this point, all unblocked attackers other than |attacker| have been
-    // added to |attackers|. Now play out all possible captures in order of
-    // increasing piece value (but starting with |attacker|) while alternating
-    // colors. Whenever a capture is made, add any x-ray attackers that removal
-    // of the piece would reveal.
     color_t side = piece_color(attacker);
-    initial_attacker[side] = 1;
-    int gain[32] = { material_value(captured) };
+    int gain[32] = { material_value(get_move_capture(move)) };
     int gain_index = 1;
     int capture_value = material_value(attacker);
-    bool initial_attack = true;
-    while (num_attackers[side] + initial_attacker[side] + 1 || initial_attack) {
-        initial_attack = false;
-        // add in any new x-ray attacks
-        const attack_data_t* att_data =
-            &get_attack_data(attacker_sq, attacked_sq);
-        if (att_data->possible_attackers & Q_FLAG) {
-            square_t sq;
-            for (sq=attacker_sq - att_data->relative_direction;
-                    pos->board[sq] == EMPTY;
-                    sq -= att_data->relative_direction) {}
-            if (pos->board[sq] != OUT_OF_BOUNDS) {
-                const piece_t xray_piece = pos->board[sq];
-                if (att_data->possible_attackers & 
-                        get_piece_flag(xray_piece)) {
-                    const color_t xray_color = piece_color(xray_piece);
-                    index = num_attackers[xray_color]++;
-                    attacker_sqs[xray_color][index] = sq;
-                }
-            }
-        }
-
+    while (true) {
         // score the capture under the assumption that it's defended.
         gain[gain_index] = capture_value - gain[gain_index - 1];
         ++gain_index;
         side = flip_color(side);
 
         // find the next lowest valued attacker
-        int least_value = material_value(KING)+1;
-        int att_index = -1;
-        for (int i=0; i<num_attackers[side]; ++i) {
-            capture_value = material_value(pos->board[attacker_sqs[side][i]]);
-            if (capture_value < least_value) {
-                least_value = capture_value;
-                att_index = i;
-            }
+        bitboard_t side_attackers = attackers & pos->occupied_bb[side];
+        if (pinners[side] & occupied & survivors) {
+            side_attackers &= ~pinned[side];
+        }
+        if (!side_attackers) break;
+        bitboard_t candidates = EMPTY_BB;
+        piece_type_t type = NONE;
+        for (int i=0; !candidates; ++i) {
+            type = exchange_order[i];
+            candidates = side_attackers & bb[create_piece(side, type)];
         }
-        if (att_index == -1) {
-            assert(num_attackers[side] == 0);
-            break;
+        if (type == KING &&
+                (attackers & pos->occupied_bb[flip_color(side)])) break;
+        occupied ^= candidates & -candidates;
+
+        // add in any new x-ray attacks
+        if (type == PAWN || type == BISHOP || type == QUEEN) {
+            attackers |= bishop_attacks(to_index, occupied) & diagonals;
         }
-        attacker = pos->board[attacker_sqs[side][att_index]];
-        attacker_sq = attacker_sqs[side][att_index];
-        index = --num_attackers[side];
-        attacker_sqs[side][att_index] = attacker_sqs[side][index];
-        capture_value = least_value;
-        if (piece_type(attacker) == KING && num_attackers[side^1]) break;
+        if (type == ROOK || type == QUEEN) {
+            attackers |= rook_attacks(to_index, occupied) & straights;
+        }
+        attackers &= occupied;
+        capture_value = material_value(create_piece(side, type));
     }
 
     // Now that gain array is set up, scan back through to get score.
@@ -135,6 +105,26 @@ int static_exchange_eval(const position_t* pos, move_t move)
     return gain[0];
 }
 
+/*
+ * Count all attackers and defenders of a square to determine whether or not
+ * a capture is advantageous. Captures with a positive static eval are
+ * favorable.
+ */
+int static_exchange_eval(const position_t* pos, move_t move)
+{
+    instrument_scope(TIMER_SEE);
+    const uint64_t key = see_cache_key(pos->hash, move);
+    see_cache_entry_t* entry = &see_cache[key & (SEE_CACHE_BUCKETS - 1)];
+    const see_cache_entry_t cached = *entry;
+    if (!((cached ^ key) & see_cache_key_mask)) {
+        instrument_count(COUNTER_SEE_CACHE_HITS);
+        return (int16_t)(cached & 0xffff);
+    }
+    const int score = compute_static_exchange_eval(pos, move);
+    *entry = (key & see_cache_key_mask) | (uint16_t)score;
+    return score;
+}
+
 /*
  * If we only care about whether or not a move is losing, sometimes we don't
  * need a full static exchange eval and can bail out early.
@@ -146,3 +136,12 @@ int static_exchange_sign(const position_t* pos, move_t move)
     if (attacker_type == KING || attacker_type <= captured_type) return 1;
     return static_exchange_eval(pos, move);
 }
+
+/*
+ * Forget all cached exchange scores for the calling thread. Only needed to
+ * time the exchange evaluation itself.
+ */
+void clear_see_cache(void)
+{
+    memset(see_cache, 0, sizeof(see_cache));
+}
@@ -1,5 +1,6 @@
 
 #include "daydreamer.h"
+#include <time.h>
 
 /*
  * Initialize a timer.
@@ -52,3 +53,21 @@ int elapsed_time(milli_timer_t* timer)
     return timer->elapsed_millis;
 }
 
+
+/*
+ * Read a monotonic clock with nanosecond units, for timing things too short
+ * for a millisecond timer. Only differences between readings mean anything.
+ */
+uint64_t nanosecond_clock(void)
+{
+#ifdef _WIN32
+    LARGE_INTEGER count, frequency;
+    QueryPerformanceCounter(&count);
+    QueryPerformanceFrequency(&frequency);
+    return (uint64_t)(count.QuadPart / (double)frequency.QuadPart * 1e9);
+#else
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ull + ts.tv_nsec;
+#endif
+}
@@ -6,12 +6,22 @@
 
 static const int bucket_size = 4;
 static size_t num_buckets;
+static size_t table_bytes;
+static uint64_t bucket_mask;
+static table_memory_t table_memory;
 static int generation;
 static const int generation_limit = 8;
 static int age_score_table[8];
-static transposition_entry_t* transposition_table = NULL;
+static transposition_slot_t* transposition_table = NULL;
+static replacement_scheme_t replacement_scheme = REPLACE_DEPTH_AGE;
 
-static struct {
+// Number of entries in the table at each draft, used by the equidistributed
+// draft replacement scheme. These are shared and updated without locking,
+// so with several threads they're only approximately right, which is all
+// the replacement decision needs.
+static volatile int64_t draft_counts[DRAFT_BUCKETS];
+
+typedef struct {
     uint64_t misses;
     uint64_t hits;
     uint64_t occupied;
@@ -20,41 +30,171 @@ static struct {
     uint64_t exact;
     uint64_t evictions;
     uint64_t collisions;
-} hash_stats;
+    uint64_t draft_evictions[DRAFT_BUCKETS];
+} hash_stats_t;
+
+// Each thread keeps its own counters, in whole cache lines, so that
+// probing doesn't bounce shared lines between processors. They're only
+// summed when someone asks for them.
+static CACHE_ALIGN hash_stats_t thread_hash_stats[MAX_THREADS];
+static THREAD_LOCAL hash_stats_t* hash_stats = &thread_hash_stats[0];
+
+/*
+ * Packing and unpacking of the data word stored in each slot. The flags are
+ * never zero for a stored entry, so an empty slot has a zero data word.
+ */
+#define DEPTH_SCALE         256.0
+#define slot_flags(d)       ((int)(((d) >> 25) & 0x07))
+#define slot_age(d)         ((int)(((d) >> 28) & 0x07))
+#define slot_depth(d)       ((float)(((d) >> 32) & 0xffff) / DEPTH_SCALE)
+#define slot_score(d)       ((int)(int16_t)((d) >> 48))
+#define slot_draft(d)       MIN((int)(((d) >> 40) & 0xff), DRAFT_BUCKETS-1)
+
+static move_t unpack_move(uint64_t d)
+{
+    square_t from = (square_t)index_to_square(d & 0x3f);
+    square_t to = (square_t)index_to_square((d >> 6) & 0x3f);
+    move_t move = from | (to << 8) | (((d >> 12) & 0xff) << 16) |
+        (((d >> 20) & 0x07) << 24);
+    if (d & (1<<23)) move |= ENPASSANT_FLAG;
+    if (d & (1<<24)) move |= CASTLE_FLAG;
+    return move;
+}
 
-// TODO: look into "equidistributed draft" method
-#define entry_replace_score(entry) \
-    (age_score_table[(entry)->age] - (entry)->depth)
+static uint64_t pack_entry(move_t move,
+        float depth,
+        int score,
+        int age,
+        int flags)
+{
+    uint64_t d = 0;
+    if (move != NO_MOVE) {
+        d = (square_to_index(get_move_from(move))) |
+            ((square_to_index(get_move_to(move))) << 6) |
+            (((move >> 16) & 0xff) << 12) |
+            (get_move_promote(move) << 20) |
+            (is_move_enpassant(move) << 23) |
+            (is_move_castle(move) << 24);
+    }
+    int fixed_depth = MIN((int)(depth * DEPTH_SCALE + 0.5), 0xffff);
+    return d | ((uint64_t)flags << 25) | ((uint64_t)age << 28) |
+        ((uint64_t)fixed_depth << 32) | ((uint64_t)(uint16_t)score << 48);
+}
+
+static void write_slot(transposition_slot_t* slot, hashkey_t key, uint64_t d)
+{
+    slot->data = d;
+    slot->check = key ^ d;
+}
+
+// Parallel epd runs give each thread a slice of the table of its own, so
+// that searches of unrelated positions don't evict each other's entries.
+// Everywhere else the slice is the whole table.
+static THREAD_LOCAL uint64_t partition_mask = ~(uint64_t)0;
+static THREAD_LOCAL size_t partition_base = 0;
+
+#define bucket_index(key)   \
+    ((((key) & bucket_mask & partition_mask) + partition_base) * bucket_size)
+
+#define slot_replace_score(d) \
+    (age_score_table[slot_age(d)] - slot_depth(d))
 
 static void set_transposition_age(int age);
 
 /*
- * Create a transposition table of the appropriate size.
+ * Set the size of the transposition table. The memory isn't allocated until
+ * the table is actually needed, so that the default size set at startup
+ * doesn't cost anything if the gui asks for a different one.
  */
 void init_transposition_table(const size_t max_bytes)
 {
     assert(max_bytes >= 1024);
-    size_t size = sizeof(transposition_entry_t) * bucket_size;
+    size_t size = sizeof(transposition_slot_t) * bucket_size;
     num_buckets = 1;
     while (size <= max_bytes >> 1) {
         size <<= 1;
         num_buckets <<= 1;
     }
-    if (transposition_table) free(transposition_table);
-    transposition_table = (transposition_entry_t*)malloc(size);
-    assert(transposition_table);
-    clear_transposition_table();
+    bucket_mask = num_buckets - 1;
+    table_bytes = size;
+    free_table_memory(&table_memory);
+    transposition_table = NULL;
     set_transposition_age(0);
 }
 
 /*
- * Wipe the entire table.
+ * Recount the number of entries at each draft from scratch.
+ */
+static void count_drafts(void)
+{
+    memset((void*)draft_counts, 0, sizeof(draft_counts));
+    if (!transposition_table) return;
+    for (size_t i=0; i<num_buckets*bucket_size; ++i) {
+        uint64_t d = transposition_table[i].data;
+        if (d) draft_counts[slot_draft(d)]++;
+    }
+}
+
+/*
+ * Choose how entries are picked for replacement. Depth-age replacement
+ * evicts the shallowest, oldest entry in a bucket. Equidistributed draft
+ * replacement evicts entries from previous searches first, and otherwise
+ * the entry whose draft is most common in the table, which tends toward
+ * an equal number of entries at each draft and keeps deep results alive.
+ */
+void set_transposition_replacement(replacement_scheme_t scheme)
+{
+    if (scheme == REPLACE_EQUIDISTRIBUTED &&
+            replacement_scheme != REPLACE_EQUIDISTRIBUTED) count_drafts();
+    replacement_scheme = scheme;
+}
+
+/*
+ * Allocate the table if that hasn't happened yet. Must be called before the
+ * table is used.
+ */
+void sync_transposition_table(void)
+{
+    if (transposition_table) return;
+
+    // Table memory is page aligned, and buckets are exactly one cache line,
+    // so each probe is a single miss.
+    bool allocated = alloc_table_memory(&table_memory, table_bytes);
+    assert(allocated);
+    (void)allocated;
+    transposition_table = (transposition_slot_t*)table_memory.base;
+    if (!root_data.quiet) {
+        printf("info string hash table %d MB, %d KB pages%s\n",
+                (int)(table_bytes >> 20), (int)(table_memory.page_bytes >> 10),
+                table_memory.transparent_huge_pages ?
+                " (transparent huge pages requested)" : "");
+    }
+    clear_transposition_table();
+}
+
+/*
+ * Zero this thread's share of the table. Because fresh pages are physically
+ * allocated on first touch, this also spreads the table across the memory
+ * local to each search thread.
+ */
+static void clear_table_slice(int thread_id, int num_threads, void* arg)
+{
+    (void)arg;
+    size_t slice = (num_buckets + num_threads - 1) / num_threads;
+    size_t begin = MIN(num_buckets, slice * thread_id);
+    size_t end = MIN(num_buckets, begin + slice);
+    memset(&transposition_table[begin * bucket_size], 0,
+            sizeof(transposition_slot_t) * bucket_size * (end - begin));
+}
+
+/*
+ * Wipe the entire table, splitting the work between all search threads.
  */
 void clear_transposition_table(void)
 {
-    memset(transposition_table, 0,
-            sizeof(transposition_entry_t)*bucket_size*num_buckets);
-    memset(&hash_stats, 0, sizeof(hash_stats));
+    if (transposition_table) run_on_all_threads(clear_table_slice, NULL);
+    memset(thread_hash_stats, 0, sizeof(thread_hash_stats));
+    memset((void*)draft_counts, 0, sizeof(draft_counts));
 }
 
 /*
@@ -71,7 +211,7 @@ static void set_transposition_age(int age)
         if (age < 0) age += generation_limit;
         age_score_table[i] = age * 128;
     }
-    memset(&hash_stats, 0, sizeof(hash_stats));
+    memset(thread_hash_stats, 0, sizeof(thread_hash_stats));
 }
 
 /*
@@ -84,22 +224,145 @@ void increment_transposition_age(void)
 }
 
 /*
- * Get the entry for the given position, if it exists.
+ * Direct this thread's hash statistics to the counters for |thread_id|.
+ * Must be called by each search thread before it uses the table.
  */
-transposition_entry_t* get_transposition(position_t* pos)
+void set_transposition_thread(int thread_id)
 {
-    transposition_entry_t* entry;
-    entry = &transposition_table[(pos->hash % num_buckets) * bucket_size];
-    for (int i=0; i<bucket_size; ++i, ++entry) {
-        if (!entry->key || entry->key != pos->hash) continue;
-        hash_stats.hits++;
+    assert(thread_id >= 0 && thread_id < MAX_THREADS);
+    hash_stats = &thread_hash_stats[thread_id];
+}
+
+/*
+ * Restrict this thread to slice |part| of the table, out of |num_parts|
+ * equal slices. The number of slices is rounded up to a power of two, so
+ * some of the table may go unused. Passing a single part gives the thread
+ * the whole table again.
+ */
+void set_transposition_partition(int part, int num_parts)
+{
+    assert(part >= 0 && part < num_parts);
+    size_t slices = 1;
+    while (slices < (size_t)num_parts && slices < num_buckets) slices <<= 1;
+    if (slices == 1) {
+        partition_mask = ~(uint64_t)0;
+        partition_base = 0;
+        return;
+    }
+    size_t slice_buckets = num_buckets / slices;
+    partition_mask = slice_buckets - 1;
+    partition_base = (part % slices) * slice_buckets;
+}
+
+/*
+ * Wipe the part of the table that this thread is using.
+ */
+void clear_transposition_partition(void)
+{
+    if (!transposition_table) return;
+    size_t buckets = MIN((uint64_t)num_buckets - 1, partition_mask) + 1;
+    memset(&transposition_table[partition_base * bucket_size], 0,
+            sizeof(transposition_slot_t) * bucket_size * buckets);
+}
+
+/*
+ * Start loading the bucket for |hash| into cache. This is called from
+ * do_move as soon as the new hash is known, so that the memory access
+ * overlaps with the rest of the move and the probe that follows is a hit.
+ */
+void prefetch_transposition(hashkey_t hash)
+{
+    if (!transposition_table) return;
+    prefetch(&transposition_table[bucket_index(hash)]);
+}
+
+/*
+ * Get the entry for the given position, if it exists. The entry is copied
+ * into |entry|, so it stays valid even if another thread overwrites the
+ * table slot. Returns NULL if the position isn't found, or if the table
+ * hasn't been allocated yet.
+ */
+transposition_entry_t* get_transposition(position_t* pos,
+        transposition_entry_t* entry)
+{
+    instrument_scope(TIMER_TT_PROBE);
+    if (!transposition_table) return NULL;
+    transposition_slot_t* slot = &transposition_table[bucket_index(pos->hash)];
+    for (int i=0; i<bucket_size; ++i, ++slot) {
+        uint64_t d = slot->data;
+        if (!d || (slot->check ^ d) != pos->hash) continue;
+        hash_stats->hits++;
+        instrument_count(COUNTER_TT_HITS);
+        instrument_histogram(HISTOGRAM_TT_HIT_DEPTH, (int)slot_depth(d));
+        if (slot_age(d) != generation) {
+            d = (d & ~((uint64_t)0x07 << 28)) | ((uint64_t)generation << 28);
+            write_slot(slot, pos->hash, d);
+        }
+        entry->key = pos->hash;
+        entry->move = unpack_move(d);
+        entry->depth = slot_depth(d);
+        entry->score = slot_score(d);
         entry->age = generation;
+        entry->flags = slot_flags(d);
         return entry;
     }
-    hash_stats.misses++;
+    hash_stats->misses++;
     return NULL;
 }
 
+/*
+ * Store |new_d| in the bucket starting at |slot| using the equidistributed
+ * draft scheme. Empty slots are used first, then entries from previous
+ * searches, and after that the entry whose draft is most common.
+ */
+static void put_transposition_equidistributed(transposition_slot_t* slot,
+        hashkey_t key,
+        uint64_t new_d)
+{
+    transposition_slot_t* best_slot = NULL;
+    uint64_t best_d = 0;
+    int best_age_score = -1;
+    int64_t best_count = -1;
+    for (int i=0; i<bucket_size; ++i, ++slot) {
+        uint64_t d = slot->data;
+        if ((slot->check ^ d) == key) {
+            // Update an existing entry
+            draft_counts[slot_draft(d)]--;
+            draft_counts[slot_draft(new_d)]++;
+            write_slot(slot, key, new_d);
+            switch (slot_flags(d) & SCORE_MASK) {
+                case SCORE_LOWERBOUND: hash_stats->beta--; break;
+                case SCORE_UPPERBOUND: hash_stats->alpha--; break;
+                case SCORE_EXACT: hash_stats->exact--;
+            }
+            return;
+        }
+        if (!d) {
+            best_slot = slot;
+            best_d = d;
+            break;
+        }
+        int age_score = age_score_table[slot_age(d)];
+        int64_t count = draft_counts[slot_draft(d)];
+        if (age_score > best_age_score ||
+                (age_score == best_age_score && count > best_count)) {
+            best_slot = slot;
+            best_d = d;
+            best_age_score = age_score;
+            best_count = count;
+        }
+    }
+    assert(best_slot != NULL);
+    if (!best_d || slot_age(best_d) != generation) hash_stats->occupied++;
+    else {
+        ++hash_stats->evictions;
+        ++hash_stats->draft_evictions[slot_draft(best_d)];
+    }
+    if (best_d) draft_counts[slot_draft(best_d)]--;
+    draft_counts[slot_draft(new_d)]++;
+    write_slot(best_slot, key, new_d);
+}
+
 /*
  * Place a position into the table, giving the score, depth searched,
  * and recommended move.
@@ -111,52 +374,122 @@ void put_transposition(position_t* pos,
         score_type_t score_type,
         bool mate_threat)
 {
+    instrument_scope(TIMER_TT_STORE);
+    if (!transposition_table) return;
     if (depth < 0) depth = 0;
-    transposition_entry_t* entry, *best_entry = NULL;
+    transposition_slot_t* slot, *best_slot = NULL;
+    uint64_t best_d = 0;
     int replace_score, best_replace_score = INT_MIN;
-    entry = &transposition_table[(pos->hash % num_buckets) * bucket_size];
-    for (int i=0; i<bucket_size; ++i, ++entry) {
-        if (entry->key == pos->hash) {
+    uint64_t new_d = pack_entry(move, depth, score, generation,
+            score_type | mate_threat);
+    switch (score_type) {
+        case SCORE_LOWERBOUND: hash_stats->beta++; break;
+        case SCORE_UPPERBOUND: hash_stats->alpha++; break;
+        case SCORE_EXACT: hash_stats->exact++;
+    }
+    slot = &transposition_table[bucket_index(pos->hash)];
+    if (replacement_scheme == REPLACE_EQUIDISTRIBUTED) {
+        put_transposition_equidistributed(slot, pos->hash, new_d);
+        return;
+    }
+    for (int i=0; i<bucket_size; ++i, ++slot) {
+        uint64_t d = slot->data;
+        if ((slot->check ^ d) == pos->hash) {
             // Update an existing entry
-            entry->age = generation;
-            entry->depth = depth;
-            entry->move = move;
-            entry->score = score;
-            entry->flags = score_type | mate_threat;
-            switch (score_type) {
-                case SCORE_LOWERBOUND: hash_stats.beta++; break;
-                case SCORE_UPPERBOUND: hash_stats.alpha++; break;
-                case SCORE_EXACT: hash_stats.exact++;
-            }
-            switch (entry->flags & SCORE_MASK) {
-                case SCORE_LOWERBOUND: hash_stats.beta--; break;
-                case SCORE_UPPERBOUND: hash_stats.alpha--; break;
-                case SCORE_EXACT: hash_stats.exact--;
+            write_slot(slot, pos->hash, new_d);
+            switch (slot_flags(d) & SCORE_MASK) {
+                case SCORE_LOWERBOUND: hash_stats->beta--; break;
+                case SCORE_UPPERBOUND: hash_stats->alpha--; break;
+                case SCORE_EXACT: hash_stats->exact--;
             }
             return;
         }
-        replace_score = entry_replace_score(entry);
+        replace_score = slot_replace_score(d);
         if (replace_score > best_replace_score) {
-            best_entry = entry;
+            best_slot = slot;
+            best_d = d;
             best_replace_score = replace_score;
         }
     }
     // Replace the entry with the highest replace score.
-    assert(best_entry != NULL);
-    entry = best_entry;
-    if (!entry->key || entry->age != generation) hash_stats.occupied++;
-    else ++hash_stats.evictions;
-    switch (score_type) {
-        case SCORE_LOWERBOUND: hash_stats.beta++; break;
-        case SCORE_UPPERBOUND: hash_stats.alpha++; break;
-        case SCORE_EXACT: hash_stats.exact++;
+    assert(best_slot != NULL);
+    if (!best_d || slot_age(best_d) != generation) hash_stats->occupied++;
+    else {
+        ++hash_stats->evictions;
+        ++hash_stats->draft_evictions[slot_draft(best_d)];
+    }
+    write_slot(best_slot, pos->hash, new_d);
+}
+
+/*
+ * Write the table to |filename|, along with enough information to restore
+ * it exactly, including the current age.
+ */
+bool save_transposition_table(const char* filename)
+{
+    sync_transposition_table();
+    FILE* file = fopen(filename, "wb");
+    if (!file) return false;
+    char header_bytes[TABLE_FILE_HEADER_BYTES];
+    memset(header_bytes, 0, TABLE_FILE_HEADER_BYTES);
+    transposition_file_header_t* header =
+        (transposition_file_header_t*)header_bytes;
+    strcpy(header->magic, TABLE_FILE_MAGIC);
+    header->version = TABLE_FILE_VERSION;
+    header->slot_bytes = sizeof(transposition_slot_t);
+    header->bucket_size = bucket_size;
+    header->generation = generation;
+    header->num_buckets = num_buckets;
+    bool ok = fwrite(header_bytes, TABLE_FILE_HEADER_BYTES, 1, file) == 1;
+    const char* table = (const char*)transposition_table;
+    size_t done = 0;
+    while (ok && done < table_bytes) {
+        size_t n = fwrite(table + done, 1,
+                MIN(table_bytes - done, (size_t)1<<30), file);
+        ok = n > 0;
+        done += n;
+    }
+    return !fclose(file) && ok;
+}
+
+/*
+ * Replace the table with one saved by save_transposition_table. The table
+ * takes on the size of the saved one, and the file is mapped rather than
+ * read, so pages are only loaded as the search touches them.
+ */
+bool load_transposition_table(const char* filename)
+{
+    FILE* file = fopen(filename, "rb");
+    if (!file) return false;
+    transposition_file_header_t header;
+    bool ok = fread(&header, sizeof(header), 1, file) == 1;
+    fclose(file);
+    if (!ok ||
+            strncmp(header.magic, TABLE_FILE_MAGIC, sizeof(header.magic)) ||
+            header.version != TABLE_FILE_VERSION ||
+            header.slot_bytes != sizeof(transposition_slot_t) ||
+            header.bucket_size != (uint32_t)bucket_size ||
+            header.generation >= (uint32_t)generation_limit ||
+            !header.num_buckets ||
+            (header.num_buckets & (header.num_buckets - 1)) ||
+            header.num_buckets > ((uint64_t)MAX_HASH_MBYTES << 20) /
+            (sizeof(transposition_slot_t) * bucket_size)) return false;
+
+    size_t bytes = sizeof(transposition_slot_t) * bucket_size *
+        header.num_buckets;
+    table_memory_t mem;
+    if (!map_table_file(&mem, filename, TABLE_FILE_HEADER_BYTES, bytes)) {
+        return false;
     }
-    entry->age = generation;
-    entry->key = pos->hash;
-    entry->move = move;
-    entry->depth = depth;
-    entry->score = score;
-    entry->flags = score_type | mate_threat;
+    free_table_memory(&table_memory);
+    table_memory = mem;
+    transposition_table = (transposition_slot_t*)table_memory.base;
+    num_buckets = header.num_buckets;
+    bucket_mask = num_buckets - 1;
+    table_bytes = bytes;
+    set_transposition_age(header.generation);
+    if (replacement_scheme == REPLACE_EQUIDISTRIBUTED) count_drafts();
+    return true;
 }
 
 /*
@@ -179,23 +512,65 @@ void put_transposition_line(position_t* pos,
     undo_move(pos, *moves, &undo);
 }
 
+/*
+ * Add up the hash statistics of all threads.
+ */
+static void sum_hash_stats(hash_stats_t* total)
+{
+    memset(total, 0, sizeof(hash_stats_t));
+    for (int i=0; i<MAX_THREADS; ++i) {
+        total->misses += thread_hash_stats[i].misses;
+        total->hits += thread_hash_stats[i].hits;
+        total->occupied += thread_hash_stats[i].occupied;
+        total->alpha += thread_hash_stats[i].alpha;
+        total->beta += thread_hash_stats[i].beta;
+        total->exact += thread_hash_stats[i].exact;
+        total->evictions += thread_hash_stats[i].evictions;
+        total->collisions += thread_hash_stats[i].collisions;
+        for (int d=0; d<DRAFT_BUCKETS; ++d) {
+            total->draft_evictions[d] +=
+                thread_hash_stats[i].draft_evictions[d];
+        }
+    }
+}
+
 /*
  * Print some stats about the transposition table.
  */
 void print_transposition_stats(void)
 {
+    hash_stats_t stats;
+    sum_hash_stats(&stats);
     int num_entries = num_buckets * bucket_size;
     printf("info string hash entries %d", num_entries);
-    printf(" filled %"PRIu64" (%.2f%%)", hash_stats.occupied,
-            (float)hash_stats.occupied / (float)num_entries * 100.);
-    printf(" evictions %"PRIu64, hash_stats.evictions);
-    printf(" hits %"PRIu64" (%.2f%%)", hash_stats.hits,
-            (float)hash_stats.hits / (hash_stats.hits+hash_stats.misses)*100.);
-    printf(" misses %"PRIu64" (%.2f%%)", hash_stats.misses,
-            (float)hash_stats.misses/(hash_stats.hits+hash_stats.misses)*100.);
-    printf(" alpha %"PRIu64"", hash_stats.alpha);
-    printf(" beta %"PRIu64"", hash_stats.beta);
-    printf(" exact %"PRIu64"\n", hash_stats.exact);
+    printf(" filled %"PRIu64" (%.2f%%)", stats.occupied,
+            (float)stats.occupied / (float)num_entries * 100.);
+    printf(" evictions %"PRIu64, stats.evictions);
+    printf(" hits %"PRIu64" (%.2f%%)", stats.hits,
+            (float)stats.hits / (stats.hits+stats.misses)*100.);
+    printf(" misses %"PRIu64" (%.2f%%)", stats.misses,
+            (float)stats.misses/(stats.hits+stats.misses)*100.);
+    printf(" alpha %"PRIu64"", stats.alpha);
+    printf(" beta %"PRIu64"", stats.beta);
+    printf(" exact %"PRIu64"\n", stats.exact);
+
+    // Count entries by draft. Big tables are sampled rather than scanned,
+    // so this stays cheap enough to print after every iteration.
+    if (!transposition_table) return;
+    uint64_t entries[DRAFT_BUCKETS] = { 0 };
+    size_t sample = MIN(num_buckets, (size_t)1<<16) * bucket_size;
+    for (size_t i=0; i<sample; ++i) {
+        uint64_t d = transposition_table[i].data;
+        if (d) entries[slot_draft(d)]++;
+    }
+    printf("info string hash drafts (entries/evictions, %d%% sampled)",
+            (int)(100 * sample / (num_buckets * bucket_size)));
+    for (int d=0; d<DRAFT_BUCKETS; ++d) {
+        if (!entries[d] && !stats.draft_evictions[d]) continue;
+        printf(" %d%s:%"PRIu64"/%"PRIu64, d, d == DRAFT_BUCKETS-1 ? "+" : "",
+                entries[d], stats.draft_evictions[d]);
+    }
+    printf("\n");
 }
 
 /*
@@ -203,6 +578,8 @@ void print_transposition_stats(void)
  */
 int get_hashfull(void)
 {
-    return MIN(1000 * hash_stats.occupied / (num_buckets * bucket_size), 1000);
+    hash_stats_t stats;
+    sum_hash_stats(&stats);
+    return MIN(1000 * stats.occupied / (num_buckets * bucket_size), 1000);
 }
 
@@ -5,7 +5,18 @@
 extern "C" {
 #endif
 
-// TODO: shrink this structure.
+#ifdef ARCH_64_BIT
+#define MAX_HASH_MBYTES     65536
+#else
+#define MAX_HASH_MBYTES     2048   // 4096 MB would overflow a 32-bit size_t
+#endif
+
+#define DRAFT_BUCKETS       32
+
+typedef enum {
+    REPLACE_DEPTH_AGE, REPLACE_EQUIDISTRIBUTED
+} replacement_scheme_t;
+
 // TODO: track mate threats and whether null moves should be attempted
 typedef struct {
     hashkey_t key;
@@ -16,6 +27,42 @@ typedef struct {
     uint8_t flags;
 } transposition_entry_t;
 
+/*
+ * The table itself stores entries packed into a single 64-bit data word, so
+ * that four of them fill one cache line and can be shared between threads
+ * without locking. The key is stored xor'd with the data, so an entry that
+ * was torn by concurrent writes fails to match its position and is treated
+ * as a miss. The data word is laid out as follows:
+ *
+ * bits 0-24   move, with squares stored as 0-63 indices
+ * bits 25-27  flags
+ * bits 28-30  age
+ * bits 32-47  depth, in 1/256ths of a ply
+ * bits 48-63  score
+ */
+typedef struct {
+    volatile uint64_t check;
+    volatile uint64_t data;
+} transposition_slot_t;
+
+/*
+ * Saved tables start with this header, padded out to TABLE_FILE_HEADER_BYTES
+ * so that the slots that follow can be mapped straight into memory. Files
+ * are written in native byte order and aren't portable between machines
+ * of different endianness.
+ */
+#define TABLE_FILE_MAGIC            "DDHASH"
+#define TABLE_FILE_VERSION          1
+#define TABLE_FILE_HEADER_BYTES     4096
+typedef struct {
+    char magic[8];
+    uint32_t version;
+    uint32_t slot_bytes;
+    uint32_t bucket_size;
+    uint32_t generation;
+    uint64_t num_buckets;
+} transposition_file_header_t;
+
 #ifdef __cplusplus
 } // extern "C"
 #endif
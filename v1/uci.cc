@@ -31,24 +31,48 @@ static void uci_print_help(void)
 "standard UCI commands, Daydreamer understands some non-standard commands:\n"
 "\n"
 "    print     \tPrint the current position, along with some evaluation info.\n"
-"    perft <n>  \tPrint the number of positions that could be reached from the "
-"               \tcurrent position in exactly <n> moves.\n"
-"    divide <n> \tThe same as perft, but break numbers down by root move.\n"
+"    perft <n> [threads <t>]\n"
+"               \tPrint the number of positions that could be reached from the\n"
+"               \tcurrent position in exactly <n> moves, using <t> threads\n"
+"               \t(default: the Threads option), and the speed in Mnps.\n"
+"    divide <n> [threads <t>]\n"
+"               \tThe same as perft, but break numbers down by root move.\n"
 "    see <move> \tPrint the static exchange evaluation score of the given "
 "move.\n"
-"    bench <depth>\n"
-"               \tSearch a fixed set of positions to the given depth, and\n"
-"               \treport the total nodes searched and time taken.\n"
+"    bench [depth <d>] [nodes <n>] [time <ms>] [hash <mb>] [threads <t>]\n"
+"          [repeat <r>] [file <filename>] [format text|json|csv]\n"
+"               \tSearch a fixed set of positions (or the fen/epd lines in\n"
+"               \t<filename>) within the given limits, <r> times over, and\n"
+"               \treport nodes, time, speed and best move per position, the\n"
+"               \tmedian and standard deviation over repeats, and a node\n"
+"               \tcount signature. \"bench <d>\" searches to depth <d>.\n"
+"    microbench [positions <n>] [time <ms>] [<name>...]\n"
+"               \tTime individual primitives (move making, move generation,\n"
+"               \tevaluation, SEE, hashing, hash table access) over a fixed\n"
+"               \tcorpus of <n> positions for at least <ms> ms each, and\n"
+"               \treport ns and cycles per call. Names limit the run to\n"
+"               \tprimitives containing one of them, eg \"microbench eval\".\n"
+"    instrument [reset]\n"
+"               \tPrint the counters, cycle timers and histograms recorded\n"
+"               \tsince the last reset, or reset them. Only available in\n"
+"               \tbuilds made with \"make instrument\".\n"
 "    perftsuite <filename>\n"
 "               \tRun a suite of perft tests from a file in the format\n"
 "               \tdescribed at www.rocechess.ch/rocee.html\n"
-"   epd <filename> <time>\n"
+"   epd <filename> <time> [nodes <n>] [threads <t>]\n"
 "              \tRead the given epd file, and search each position for <time>\n"
-"               \tseconds.\n"
+"               \tseconds (0 for no limit) and at most <n> nodes. The acs and\n"
+"               \tacn opcodes override these limits for a position. With\n"
+"               \t<t> threads, <t> positions are searched at once, each on\n"
+"               \tits own thread and slice of the hash table.\n"
 "   book        \tPrint book information for the current position.\n"
 "               \tUses the currently loaded book.\n"
 "   <move>      \tMake the given move (eg e2e4) on the internal board.\n"
 "   gtb         \tLook up the current position in the Gaviota Tablebases.\n"
+"   savehash <filename>\n"
+"               \tWrite the contents of the hash table to a file.\n"
+"   loadhash <filename>\n"
+"               \tReplace the hash table with one written by savehash.\n"
 "   echo <text> \tEcho the given string to standard output.\n"
 "   help        \tPrint this help message."
 "\n\n");
@@ -82,8 +106,10 @@ static void uci_handle_command(char* command)
         printf("id author %s\n", ENGINE_AUTHOR);
         print_uci_options();
         printf("uciok\n");
-    } else if (!strncasecmp(command, "isready", 7)) printf("readyok\n");
-    else if (!strncasecmp(command, "quit", 4)) exit(0);
+    } else if (!strncasecmp(command, "isready", 7)) {
+        sync_transposition_table();
+        printf("readyok\n");
+    } else if (!strncasecmp(command, "quit", 4)) exit(0);
     else if (!strncasecmp(command, "position", 8)) uci_position(command+9);
     else if (!strncasecmp(command, "go", 2)) {
         uci_go(command+3);
@@ -123,18 +149,22 @@ static void uci_handle_ext(char* command)
         command+=10;
         while (isspace(*command)) command++;
         perft_testsuite(command);
-    } else if (!strncasecmp(command, "perft", 5)) {
-        int depth=1;
-        sscanf(command+5, " %d", &depth);
-        perft(pos, depth, false);
-    } else if (!strncasecmp(command, "divide", 6)) {
-        int depth=1;
-        sscanf(command+6, " %d", &depth);
-        perft(pos, depth, true);
+    } else if (!strncasecmp(command, "perft", 5) ||
+            !strncasecmp(command, "divide", 6)) {
+        bool div = !strncasecmp(command, "divide", 6);
+        int depth = 1, threads = get_num_threads();
+        sscanf(command + (div ? 6 : 5), " %d", &depth);
+        char* arg = strcasestr(command, "threads");
+        if (arg) sscanf(arg+7, " %d", &threads);
+        threads = CLAMP(threads, 1, MAX_THREADS);
+        perft(pos, depth, threads, div);
+    } else if (!strncasecmp(command, "instrument", 10)) {
+        if (strcasestr(command+10, "reset")) reset_instrumentation();
+        else print_instrumentation();
+    } else if (!strncasecmp(command, "microbench", 10)) {
+        microbench(command+10);
     } else if (!strncasecmp(command, "bench", 5)) {
-        int depth = 1;
-        sscanf(command+5, " %d", &depth);
-        benchmark(depth, 0);
+        benchmark(command+5);
     } else if (!strncasecmp(command, "see", 3)) {
         command += 3;
         while (isspace(*command)) command++;
@@ -142,10 +172,17 @@ static void uci_handle_ext(char* command)
         printf("see: %d\n", static_exchange_eval(pos, move));
     } else if (!strncasecmp(command, "epd", 3)) {
         char filename[256];
-        int time_per_move = 5;
-        sscanf(command+3, " %s %d", filename, &time_per_move);
+        int time_per_move = 5, threads = 1;
+        uint64_t nodes_per_move = 0;
+        sscanf(command+3, " %255s %d", filename, &time_per_move);
         time_per_move *= 1000;
-        epd_testsuite(filename, time_per_move);
+        char* arg = strcasestr(command, "threads");
+        if (arg) sscanf(arg+7, " %d", &threads);
+        threads = CLAMP(threads, 1, MAX_THREADS);
+        if ((arg = strcasestr(command, "nodes"))) {
+            sscanf(arg+5, " %"SCNu64, &nodes_per_move);
+        }
+        epd_testsuite(filename, time_per_move, nodes_per_move, threads);
     } else if (!strncasecmp(command, "gtb", 3)) {
         if (options.use_gtb) {
             int score;
@@ -170,6 +207,18 @@ static void uci_handle_ext(char* command)
                 printf("book move %s\n", move_str);
             }
         }
+    } else if (!strncasecmp(command, "savehash", 8)) {
+        command += 8;
+        while (isspace(*command)) command++;
+        if (save_transposition_table(command)) {
+            printf("info string saved hash to %s\n", command);
+        } else printf("info string unable to save hash to %s\n", command);
+    } else if (!strncasecmp(command, "loadhash", 8)) {
+        command += 8;
+        while (isspace(*command)) command++;
+        if (load_transposition_table(command)) {
+            printf("info string loaded hash from %s\n", command);
+        } else printf("info string unable to load hash from %s\n", command);
     } else if (!strncasecmp(command, "print", 5)) {
         print_board(pos, false);
         move_t moves[255];
@@ -182,7 +231,8 @@ static void uci_handle_ext(char* command)
         }
         printf("\nordered moves: ");
         move_selector_t sel;
-        init_move_selector(&sel, pos, PV_GEN, NULL, NO_MOVE, 0, 0);
+        init_move_selector(&sel, &root_data,
+                pos, PV_GEN, NULL, NO_MOVE, 0, 0);
         for (move_t move = select_move(&sel); move != NO_MOVE;
                 move = select_move(&sel)) {
             char san[8];
@@ -220,6 +270,7 @@ static void uci_position(char* uci_pos)
         while (*uci_pos && isspace(*uci_pos)) ++uci_pos;
         uci_pos = set_position(&root_data.root_pos, uci_pos);
     }
+    attach_hash_history(&root_data.root_pos, &root_data.hash_history);
     while (isspace(*uci_pos)) ++uci_pos;
     if (!strncasecmp(uci_pos, "moves", 5)) {
         uci_pos += 5;
@@ -249,6 +300,9 @@ static void uci_go(char* command)
     int wtime=0, btime=0, winc=0, binc=0, movestogo=0, movetime=0;
     bool ponder = false;
 
+    // Root moves are scored with a quiescent search, which probes the
+    // hash table, so make sure it exists before we get that far.
+    sync_transposition_table();
     init_search_data(&root_data);
     if ((info = strcasestr(command, "searchmoves"))) {
         info += 11;
@@ -262,7 +316,8 @@ static void uci_go(char* command)
             if (!is_move_legal(&root_data.root_pos, move)) {
                 printf("%s is not a legal move\n", info);
             }
-            init_root_move(&root_data.root_moves[move_index++], move);
+            init_root_move(&root_data,
+                    &root_data.root_moves[move_index++], move);
             while (*info && !isspace(*info)) ++info;
             while (isspace(*info)) ++info;
         }
@@ -106,13 +106,18 @@ void print_uci_options(void)
  */
 static uci_option_t* get_uci_option(const char* name)
 {
+    // Some option names are prefixes of others, so take the longest match.
+    uci_option_t* option = NULL;
+    int best_length = 0;
     for (int i=0; i<uci_option_count; ++i) {
         int name_length = strlen(uci_options[i].name);
-        if (!strncasecmp(name, uci_options[i].name, name_length)) {
-            return &uci_options[i];
+        if (name_length > best_length &&
+                !strncasecmp(name, uci_options[i].name, name_length)) {
+            option = &uci_options[i];
+            best_length = name_length;
         }
     }
-    return NULL;
+    return option;
 }
 
 /*
@@ -195,7 +200,7 @@ static void handle_hash(void* opt, const char* value)
         warn("Option value out of range, using default\n");
         sscanf(option->default_value, "%d", &mbytes);
     }
-    init_transposition_table(mbytes * (1ull<<20));
+    init_transposition_table((size_t)mbytes << 20);
 }
 
 /*
@@ -214,6 +219,22 @@ static void handle_pawn_cache(void* opt, const char* value)
     init_pawn_table(mbytes * (1ull<<20));
 }
 
+/*
+ * Initialize the evaluation cache.
+ */
+static void handle_eval_cache(void* opt, const char* value)
+{
+    uci_option_t* option = (uci_option_t*)opt;
+    int mbytes = 0;
+    strncpy(option->value, value, 128);
+    sscanf(value, "%d", &mbytes);
+    if (mbytes < option->min || mbytes > option->max) {
+        warn("Option value out of range, using default\n");
+        sscanf(option->default_value, "%d", &mbytes);
+    }
+    init_eval_cache(mbytes * (1ull<<20));
+}
+
 /*
  * Initialize the pv cache.
  */
@@ -230,6 +251,18 @@ static void handle_pv_cache(void* opt, const char* value)
     init_pv_cache(mbytes * (1ull<<20));
 }
 
+/*
+ * Choose the transposition table replacement scheme.
+ */
+static void handle_hash_replacement(void* opt, const char* value)
+{
+    if (!value) return;
+    uci_option_t* option = (uci_option_t*)opt;
+    strncpy(option->value, value, 128);
+    set_transposition_replacement(!strcasecmp(value, "equidistributed") ?
+            REPLACE_EQUIDISTRIBUTED : REPLACE_DEPTH_AGE);
+}
+
 /*
  * Clear the transposition table.
  */
@@ -239,6 +272,34 @@ static void handle_clear_hash(void* opt, const char* value)
     clear_transposition_table();
 }
 
+/*
+ * Set the number of search threads.
+ */
+static void handle_threads(void* opt, const char* value)
+{
+    uci_option_t* option = (uci_option_t*)opt;
+    int threads = 0;
+    strncpy(option->value, value, 128);
+    sscanf(value, "%d", &threads);
+    if (threads < option->min || threads > option->max) {
+        warn("Option value out of range, using default\n");
+        sscanf(option->default_value, "%d", &threads);
+    }
+    init_threads(threads);
+}
+
+/*
+ * Choose between shared hash and split point parallel search.
+ */
+static void handle_smp_mode(void* opt, const char* value)
+{
+    if (!value) return;
+    uci_option_t* option = (uci_option_t*)opt;
+    strncpy(option->value, value, 128);
+    options.smp_mode = SMP_SHARED_HASH;
+    if (!strcasecmp(value, "split-point")) options.smp_mode = SMP_SPLIT_POINT;
+}
+
 /*
  * Turns Gaviota tablebase use on and off.
  */
@@ -369,9 +430,22 @@ static void handle_book_file(void* opt, const char* value)
 void init_uci_options()
 {
     add_uci_option("Hash", OPTION_SPIN, "64",
-            1, 4096, NULL, NULL, &handle_hash);
+            1, MAX_HASH_MBYTES, NULL, NULL, &handle_hash);
     add_uci_option("Clear Hash", OPTION_BUTTON, "",
             0, 0, NULL, NULL, &handle_clear_hash);
+    const char* replacement_schemes[3] = {
+        "depth-age", "equidistributed", NULL
+    };
+    add_uci_option("Hash replacement", OPTION_COMBO, "depth-age",
+            0, 0, (char**)replacement_schemes, NULL,
+            &handle_hash_replacement);
+    add_uci_option("Threads", OPTION_SPIN, "1",
+            1, MAX_THREADS, NULL, NULL, &handle_threads);
+    const char* smp_modes[3] = { "shared-hash", "split-point", NULL };
+    add_uci_option("Parallel search", OPTION_COMBO, "shared-hash",
+            0, 0, (char**)smp_modes, &options.smp_mode, &handle_smp_mode);
+    add_uci_option("Split depth", OPTION_SPIN, "4",
+            1, 32, NULL, &options.split_depth, &default_handler);
     add_uci_option("Ponder", OPTION_CHECK, "false",
             0, 0, NULL, &options.ponder, &default_handler);
     add_uci_option("MultiPV", OPTION_SPIN, "1",
@@ -403,6 +477,8 @@ void init_uci_options()
             0, 0, NULL, NULL, &handle_scorpio_bb_path);
     add_uci_option("Pawn cache size", OPTION_SPIN, "1",
             1, 128, NULL, NULL, &handle_pawn_cache);
+    add_uci_option("Eval cache size", OPTION_SPIN, "4",
+            1, 1024, NULL, NULL, &handle_eval_cache);
     add_uci_option("PV cache size", OPTION_SPIN, "32",
             1, 1024, NULL, NULL, &handle_pv_cache);
     add_uci_option("Output Delay", OPTION_SPIN, "2000",